@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "FireSimulation.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Замер скорости шага на синтетических зданиях. Здание - сетка одинаковых
+// комнат за стенами, в каждой стене между соседними комнатами дверь,
+// мебель расставляется случайно по заданной смеси материалов легенды.
+// Печатает CSV: одна строка на движок и повтор.
+//
+// FireBench [--height H] [--width W] [--depth D] [--room S] [--mix t=0.2,m=0.05]
+//           [--engine 2d|3d|both] [--repeat N] [--max-steps N] [--seed S]
+//           [--threads T] [--sparse] [--events] [--domains] [--materials файл]
+//
+// Без --materials берётся fire.json из каталога FireBench (по argv[0]).
+
+struct BenchOptions {
+    int height = 200;
+    int width = 400;
+    int depth = 20;
+    int roomSize = 12;            // комната S x S клеток вместе со стеной
+    std::string mix = "t=0.15,m=0.03,f=0.02";
+    bool run2d = true;
+    bool run3d = true;
+    int repeat = 1;
+    int maxSteps = 0;             // 0 - пока пожар не погаснет
+    unsigned long long seed = 1;
+    int threads = 0;
+    bool sparse = false;
+    bool events = false;
+    bool domains = false;
+    std::string materials;
+};
+
+struct BenchResult {
+    int steps = 0;
+    double initSeconds = 0;
+    double stepSeconds = 0;
+    long long cellUpdates = 0;    // проверенные кандидаты и смены состояния
+    int peakFrontier = 0;         // кандидаты + горящие
+    long long burnt = 0;
+    double peakMemoryMb = 0;
+};
+
+// Пиковая память процесса. На Linux пик сбрасывается перед каждым прогоном
+static void resetPeakMemory() {
+#if defined(__linux__)
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        fputs("5", file);
+        fclose(file);
+    }
+#endif
+}
+
+static double peakMemoryMb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#elif defined(__linux__)
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+        }
+        fclose(file);
+        if (kb >= 0) return kb / 1024.0;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#endif
+}
+
+// Смесь "t=0.15,m=0.03": символ легенды и доля клеток комнаты
+static bool parseMix(const std::string& text, std::vector<std::pair<char, double>>& mix) {
+    mix.clear();
+    double total = 0;
+    std::size_t position = 0;
+    while (position < text.size()) {
+        std::size_t end = text.find(',', position);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(position, end - position);
+        position = end + 1;
+        if (item.size() < 3 || item[1] != '=') return false;
+        double share = atof(item.c_str() + 2);
+        if (share < 0) return false;
+        mix.push_back(std::make_pair(item[0], share));
+        total += share;
+    }
+    return total <= 1;
+}
+
+// План этажа height x width: стены по периметру и между комнатами,
+// посередине каждой внутренней стены дверь шириной 2
+static std::string buildLayer(const BenchOptions& options, const std::vector<std::pair<char, double>>& mix) {
+    int h = options.height;
+    int w = options.width;
+    int s = options.roomSize;
+    std::string layer((std::size_t)h * w, ' ');
+    std::mt19937_64 random(options.seed);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (int x = 0; x < h; x++) {
+        for (int y = 0; y < w; y++) {
+            char& cell = layer[(std::size_t)x * w + y];
+            bool border = x == 0 || y == 0 || x == h - 1 || y == w - 1;
+            bool wallX = x % s == 0;
+            bool wallY = y % s == 0;
+            if (border || (wallX && wallY)) {
+                cell = '#';
+            } else if (wallX || wallY) {
+                int along = wallX ? y % s : x % s;
+                cell = along == s / 2 || along == s / 2 + 1 ? 'd' : '#';
+            } else {
+                double u = uniform(random);
+                for (const std::pair<char, double>& item : mix) {
+                    if (u < item.second) {
+                        cell = item.first;
+                        break;
+                    }
+                    u -= item.second;
+                }
+            }
+        }
+    }
+    return layer;
+}
+
+template <class Engine>
+static bool runEngine(const BenchOptions& options, const std::string& layer, int depth, BenchResult& result) {
+    typedef std::chrono::steady_clock Clock;
+    resetPeakMemory();
+    Engine simulation;
+    simulation.setBuilding(layer.c_str(), options.height, options.width, depth);
+    simulation.setMaterials(options.materials.c_str());
+    simulation.setStartFire(options.roomSize / 2, options.roomSize / 2, depth / 2);
+    simulation.setSeed(options.seed);
+    simulation.setThreadCount(options.threads);
+    simulation.setSparseBricks(options.sparse);
+    simulation.setEventDriven(options.events);
+    simulation.setSlabDomains(options.domains);
+
+    Clock::time_point start = Clock::now();
+    if (!simulation.initialize()) return false;
+    Clock::time_point stepping = Clock::now();
+    result = BenchResult();
+    while (simulation.isActive() && (options.maxSteps <= 0 || simulation.currentStep() < options.maxSteps)) {
+        long long candidates = simulation.candidateCount();
+        simulation.stepSimulation();
+        result.cellUpdates += candidates + (long long)simulation.changedThisStep().size();
+        result.peakFrontier = std::max(result.peakFrontier, simulation.candidateCount() + simulation.burningCount());
+        for (const CellChange& change : simulation.changedThisStep()) {
+            if (change.state == BURNT) result.burnt++;
+        }
+    }
+    Clock::time_point end = Clock::now();
+    result.steps = simulation.currentStep();
+    result.initSeconds = std::chrono::duration<double>(stepping - start).count();
+    result.stepSeconds = std::chrono::duration<double>(end - stepping).count();
+    result.peakMemoryMb = peakMemoryMb();
+    simulation.finish();
+    return true;
+}
+
+static void printResult(const char* engine, int repeat, const BenchOptions& options, int depth, const BenchResult& result) {
+    double seconds = result.stepSeconds > 0 ? result.stepSeconds : 1e-9;
+    printf("%s,%d,%d,%d,%d,%d,%lld,%d,%.4f,%.4f,%.1f,%.0f,%d,%lld,%.1f\n", engine, repeat,
+           options.height, options.width, depth, options.roomSize,
+           (long long)options.height * options.width * depth, result.steps,
+           result.initSeconds, result.stepSeconds, result.steps / seconds, result.cellUpdates / seconds,
+           result.peakFrontier, result.burnt, result.peakMemoryMb);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    options.materials = besideBinary(argv[0], "fire.json");
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--height") && i + 1 < argc) options.height = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--width") && i + 1 < argc) options.width = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--depth") && i + 1 < argc) options.depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--room") && i + 1 < argc) options.roomSize = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--mix") && i + 1 < argc) options.mix = argv[++i];
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) options.repeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--max-steps") && i + 1 < argc) options.maxSteps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) options.seed = strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) options.threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--materials") && i + 1 < argc) options.materials = argv[++i];
+        else if (!strcmp(argv[i], "--sparse")) options.sparse = true;
+        else if (!strcmp(argv[i], "--events")) options.events = true;
+        else if (!strcmp(argv[i], "--domains")) options.domains = true;
+        else if (!strcmp(argv[i], "--engine") && i + 1 < argc) {
+            const char* engine = argv[++i];
+            options.run2d = !strcmp(engine, "2d") || !strcmp(engine, "both");
+            options.run3d = !strcmp(engine, "3d") || !strcmp(engine, "both");
+        } else {
+            printf("Неизвестный аргумент %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::vector<std::pair<char, double>> mix;
+    if (!parseMix(options.mix, mix)) {
+        printf("Смесь материалов: ожидается символ=доля через запятую, сумма не больше 1\n");
+        return 1;
+    }
+    if (options.roomSize < 4 || options.height < 3 || options.width < 3 || options.depth < 1 ||
+        options.roomSize / 2 >= std::min(options.height, options.width) - 1) {
+        printf("Слишком маленькое здание или комната\n");
+        return 1;
+    }
+    std::string layer = buildLayer(options, mix);
+
+    printf("engine,repeat,height,width,depth,room,cells,steps,init_s,step_s,steps_per_s,cell_updates_per_s,peak_frontier,burnt,peak_mem_mb\n");
+    for (int r = 0; r < options.repeat; r++) {
+        BenchResult result;
+        if (options.run2d) {
+            if (!runEngine<FireSimulation2D>(options, layer, 1, result)) return 1;
+            printResult("2d", r, options, 1, result);
+        }
+        if (options.run3d) {
+            if (!runEngine<FireSimulation>(options, layer, options.depth, result)) return 1;
+            printResult("3d", r, options, options.depth, result);
+        }
+    }
+    return 0;
+}
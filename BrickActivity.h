@@ -0,0 +1,46 @@
+#ifndef BRICKACTIVITY_H
+#define BRICKACTIVITY_H
+
+#include <cstdint>
+#include <vector>
+#include "FrontierSet.h"
+
+// Активность бриков (тайлов VoxelGrid): число горящих клеток в брике и
+// число горящих бриков в его окрестности 3x3x3. Брик активен, если он сам
+// или сосед содержит горящие клетки; у клеток неактивного брика fp = 0.
+// Счётчики окрестности обновляются только при переходе брика через ноль.
+class BrickActivity {
+public:
+    void reset(CellIndex bricks) {
+        burning.assign(bricks, 0);
+        nearBurning.assign(bricks, 0);
+        active = 0;
+    }
+
+    template <class Grid>
+    void addBurning(const Grid& grid, CellIndex brick) {
+        if (burning[brick]++ != 0) return;
+        grid.forEachNeighbourTile(brick, [this](CellIndex n) {
+            if (nearBurning[n]++ == 0) active++;
+        });
+    }
+
+    template <class Grid>
+    void removeBurning(const Grid& grid, CellIndex brick) {
+        if (--burning[brick] != 0) return;
+        grid.forEachNeighbourTile(brick, [this](CellIndex n) {
+            if (--nearBurning[n] == 0) active--;
+        });
+    }
+
+    bool isActive(CellIndex brick) const { return nearBurning[brick] > 0; }
+    int burningIn(CellIndex brick) const { return burning[brick]; }
+    CellIndex activeCount() const { return active; }
+
+private:
+    std::vector<std::int32_t> burning;
+    std::vector<std::uint8_t> nearBurning; // не больше 27
+    CellIndex active = 0;
+};
+
+#endif // BRICKACTIVITY_H
@@ -0,0 +1,18 @@
+#ifndef BRICKSLOT_H
+#define BRICKSLOT_H
+
+#include <atomic>
+
+// Ленивый брик в таблице, общей для потоков (CellAdjacency, Ensemble).
+// Брик заводится без блокировки: поток, не нашедший его в слоте, строит
+// свой и ставит его CAS-ом. Кто поставил первым, того брик и остаётся;
+// проигравший получает брик победителя и сам удаляет свой.
+// Возвращает брик из слота: если это не fresh, fresh проиграл
+template <class T>
+T* installBrick(std::atomic<T*>& slot, T* fresh) {
+    T* current = nullptr;
+    if (slot.compare_exchange_strong(current, fresh, std::memory_order_acq_rel)) return fresh;
+    return current;
+}
+
+#endif // BRICKSLOT_H
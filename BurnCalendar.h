@@ -0,0 +1,63 @@
+#ifndef BURNCALENDAR_H
+#define BURNCALENDAR_H
+
+#include <cstddef>
+#include <vector>
+#include "FrontierSet.h"
+
+// Календарь догорания. Шаг догорания известен в момент загорания клетки,
+// клетка кладётся в корзину due % размер; на шаге просматривается только
+// корзина этого шага. Записи на круг и больше вперёд ждут в корзине своего шага.
+class BurnCalendar {
+public:
+    // buckets - степень двойки
+    void reset(int buckets) {
+        slots.assign(buckets, std::vector<Entry>());
+        mask = buckets - 1;
+        count = 0;
+    }
+
+    void schedule(CellIndex cell, int due) {
+        slots[due & mask].push_back(Entry{cell, due});
+        count++;
+    }
+
+    // f(cell) для клеток, догорающих на шаге step, в порядке постановки
+    template <class F>
+    void retire(int step, F f) {
+        std::vector<Entry>& slot = slots[step & mask];
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < slot.size(); i++) {
+            if (slot[i].due == step) {
+                f(slot[i].cell);
+                count--;
+            } else {
+                slot[kept++] = slot[i];
+            }
+        }
+        slot.resize(kept);
+    }
+
+    // f(cell, due) для всех записей: по корзинам, в каждой в порядке постановки.
+    // schedule в том же порядке восстанавливает календарь как был
+    template <class F>
+    void forEach(F f) const {
+        for (const std::vector<Entry>& slot : slots) {
+            for (const Entry& entry : slot) f(entry.cell, entry.due);
+        }
+    }
+
+    std::size_t size() const { return count; }
+    int buckets() const { return (int)slots.size(); }
+
+private:
+    struct Entry {
+        CellIndex cell;
+        int due;
+    };
+    std::vector<std::vector<Entry>> slots;
+    int mask = 0;
+    std::size_t count = 0;
+};
+
+#endif // BURNCALENDAR_H
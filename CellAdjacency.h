@@ -0,0 +1,296 @@
+#ifndef CELLADJACENCY_H
+#define CELLADJACENCY_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include "BrickSlot.h"
+#include "FloorPlan.h"
+#include "FrontierSet.h"
+#include "Stencil.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Вклад горящего соседа в fp клетки: направление (номер смещения в
+// Stencil::FOOTPRINT) и вес ребра от соседа к клетке, умноженный на 2 или 1
+// (сосед по грани и ребру или по диагонали, как в fp = 2 * a + b)
+struct WeightedLink {
+    std::int32_t direction;
+    float weight;
+};
+
+// Строки смежности одного брика (тайла VoxelGrid). Строка есть только у
+// клеток с типом материала: present - их биты по номеру клетки в брике,
+// before - число строк в предыдущих словах present
+struct AdjacencyBrick {
+    static const int WORDS = 8; // до 512 клеток в брике
+
+    std::uint64_t present[WORDS] = {};
+    std::uint16_t before[WORDS] = {};
+    std::vector<std::uint32_t> bits;      // по строкам
+    std::vector<std::int32_t> rowOf;      // строка CSR или -1; пуст без весов
+    std::vector<std::uint32_t> rowStart;
+    std::vector<WeightedLink> links;
+
+    // Номер строки клетки или -1
+    int rowIndex(int local) const {
+        std::uint64_t word = present[local >> 6];
+        std::uint64_t bit = (std::uint64_t)1 << (local & 63);
+        if (!(word & bit)) return -1;
+        return before[local >> 6] + popcount(word & (bit - 1));
+    }
+
+private:
+    static int popcount(std::uint64_t value) {
+#ifdef _MSC_VER
+        return (int)__popcnt64(value);
+#else
+        return __builtin_popcountll(value);
+#endif
+    }
+};
+
+// Брики смежности одного плана. Строятся при первом обращении к брику
+// любым движком с этим планом и дальше не меняются
+struct AdjacencyTable {
+    AdjacencyTable(CellIndex tiles, bool weightedPlan)
+        : bricks(new std::atomic<const AdjacencyBrick*>[tiles]()), tileCount(tiles), weighted(weightedPlan) {}
+    ~AdjacencyTable() {
+        for (CellIndex t = 0; t < tileCount; t++) {
+            const AdjacencyBrick* brick = bricks[t].load(std::memory_order_relaxed);
+            if (brick != &empty()) delete brick;
+        }
+    }
+    AdjacencyTable(const AdjacencyTable&) = delete;
+    AdjacencyTable& operator=(const AdjacencyTable&) = delete;
+
+    // Общий брик без строк (одни стены или дополнение сетки)
+    static const AdjacencyBrick& empty() {
+        static const AdjacencyBrick brick;
+        return brick;
+    }
+
+    std::unique_ptr<std::atomic<const AdjacencyBrick*>[]> bricks;
+    CellIndex tileCount;
+    bool weighted; // в легенде есть множители не 1
+    FloorPlan plan; // копия плана: по ней shared различает планы с одним fingerprint
+};
+
+// Смежность клеток по плану.
+//
+// Строка клетки - биты направлений Stencil::FOOTPRINT: бит d стоит, если
+// сосед по смещению d внутри сетки, проходим и огонь переходит к нему (вес
+// ребра больше нуля); Stencil::SPREAD_MASK оставляет из них окрестность
+// распространения. Соседа даёт смещение, поэтому строка без индексов
+// занимает 4 байта; шаг обходит её биты без проверок границ и без плана.
+//
+// Вес ребра u -> v - произведение множителей материалов u и v по
+// направлению ребра (PlanMaterial::spread, spreadUp, spreadDown). Клетки, в
+// которые входит хоть одно ребро с весом не 1, получают строку в CSR
+// своего брика (rowStart, links) с вкладами соседей, и fp у них считается
+// по ней. В плане без весов CSR пуст, fp считают битовые ядра (FireKernels.h).
+//
+// Строки хранятся по брикам и строятся при первом обращении к брику, как
+// клетки в initializeTile: initialize ничего не обходит, в памяти только
+// брики, которых касался огонь, и только клетки с типом материала. Таблица
+// бриков общая для всех движков с тем же планом и раскладкой тайлов
+// (как MaterialRegistry::shared): прогоны ансамбля строят её один раз.
+template <class Stencil, class Grid>
+class CellAdjacency {
+public:
+    void attach(const Grid& grid, const FloorPlan& plan);
+    void clear();
+
+    std::uint32_t neighbours(CellIndex cell) const {
+        const AdjacencyBrick& brick = brickOf(cell);
+        int row = brick.rowIndex(localOf(cell));
+        return row < 0 ? 0 : brick.bits[row];
+    }
+    // f(direction) для соседей клетки из mask (биты направлений)
+    template <class F>
+    void forEachNeighbour(CellIndex cell, std::uint32_t mask, F f) const {
+        for (std::uint32_t rest = neighbours(cell) & mask; rest != 0; rest &= rest - 1) f(lowestBit(rest));
+    }
+
+    bool isWeighted(CellIndex cell) const { return weighted && weightedRow(cell) >= 0; }
+    // Только для isWeighted(cell)
+    const WeightedLink* rowBegin(CellIndex cell) const {
+        const AdjacencyBrick& brick = brickOf(cell);
+        return brick.links.data() + brick.rowStart[weightedRow(cell)];
+    }
+    const WeightedLink* rowEnd(CellIndex cell) const {
+        const AdjacencyBrick& brick = brickOf(cell);
+        return brick.links.data() + brick.rowStart[weightedRow(cell) + 1];
+    }
+
+private:
+    static int lowestBit(std::uint32_t value) {
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanForward(&bit, value);
+        return (int)bit;
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+    static float factor(const PlanMaterial& material, int dz) {
+        return dz > 0 ? material.spreadUp : dz < 0 ? material.spreadDown : material.spread;
+    }
+    static float edgeWeight(const PlanMaterial& from, const PlanMaterial& to, int dz) {
+        return factor(from, dz) * factor(to, dz);
+    }
+    static std::shared_ptr<AdjacencyTable> shared(const Grid& grid, const FloorPlan& plan);
+
+    int localOf(CellIndex cell) const { return (int)(cell & localMask); }
+    const AdjacencyBrick& brickOf(CellIndex cell) const {
+        CellIndex tile = cell >> tileShift;
+        const AdjacencyBrick* brick = bricks[tile].load(std::memory_order_acquire);
+        return brick ? *brick : build(tile);
+    }
+    int weightedRow(CellIndex cell) const {
+        const AdjacencyBrick& brick = brickOf(cell);
+        int row = brick.rowIndex(localOf(cell));
+        return row < 0 || brick.rowOf.empty() ? -1 : brick.rowOf[row];
+    }
+    const AdjacencyBrick& build(CellIndex tile) const;
+
+    const Grid* grid = nullptr;
+    const FloorPlan* plan = nullptr;
+    std::shared_ptr<AdjacencyTable> table;
+    // Копии из grid и table для шага
+    std::atomic<const AdjacencyBrick*>* bricks = nullptr;
+    CellIndex localMask = 0;
+    int tileShift = 0;
+    bool weighted = false;
+};
+
+template <class Stencil, class Grid>
+void CellAdjacency<Stencil, Grid>::attach(const Grid& cells, const FloorPlan& building) {
+    static_assert(Stencil::FOOTPRINT_COUNT <= 32, "строка - 32 бита");
+    grid = &cells;
+    plan = &building;
+    table = shared(cells, building);
+    bricks = table->bricks.get();
+    localMask = cells.cellsPerTile() - 1;
+    tileShift = 0;
+    while ((1 << tileShift) < cells.cellsPerTile()) tileShift++;
+    weighted = table->weighted;
+}
+
+template <class Stencil, class Grid>
+void CellAdjacency<Stencil, Grid>::clear() {
+    table.reset();
+    grid = nullptr;
+    plan = nullptr;
+    bricks = nullptr;
+    weighted = false;
+}
+
+// Таблица по плану и раскладке тайлов; у каждого Stencil своя. Реестр
+// держит таблицы через weak_ptr: таблица живёт, пока её держат движки, и
+// запись удаляется при следующем обращении. Совпавший ключ ещё сверяется
+// с копией плана в таблице - у разных планов fingerprint может совпасть
+template <class Stencil, class Grid>
+std::shared_ptr<AdjacencyTable> CellAdjacency<Stencil, Grid>::shared(const Grid& grid, const FloorPlan& plan) {
+    typedef std::tuple<std::uint64_t, int, int, int, int> Key;
+    typedef std::multimap<Key, std::weak_ptr<AdjacencyTable>> Registry;
+    static std::mutex lock;
+    static Registry tables;
+
+    Key key(plan.fingerprint(), grid.height(), grid.width(), grid.depth(), grid.cellsPerTile());
+    std::lock_guard<std::mutex> guard(lock);
+    for (typename Registry::iterator it = tables.begin(); it != tables.end();) {
+        if (it->second.expired()) it = tables.erase(it);
+        else ++it;
+    }
+    std::pair<typename Registry::iterator, typename Registry::iterator> range = tables.equal_range(key);
+    for (typename Registry::iterator it = range.first; it != range.second; ++it) {
+        std::shared_ptr<AdjacencyTable> table = it->second.lock();
+        if (table && table->plan.sameAs(plan)) return table;
+    }
+
+    bool weighted = false;
+    for (const PlanMaterial& material : plan.materials()) {
+        weighted = weighted || material.spread != 1 || material.spreadUp != 1 || material.spreadDown != 1;
+    }
+    std::shared_ptr<AdjacencyTable> table(new AdjacencyTable(grid.tileCount(), weighted));
+    table->plan.copyFrom(plan);
+    tables.emplace(key, table);
+    return table;
+}
+
+// Брик строится при первом обращении и ставится через installBrick
+template <class Stencil, class Grid>
+const AdjacencyBrick& CellAdjacency<Stencil, Grid>::build(CellIndex tile) const {
+    AdjacencyBrick* fresh = new AdjacencyBrick();
+    CellIndex first = tile * grid->cellsPerTile();
+    std::vector<WeightedLink> row;
+    for (int local = 0; local < grid->cellsPerTile(); local++) {
+        int x, y, z;
+        grid->coords(first + local, x, y, z);
+        if (!grid->inside(x, y, z)) continue;
+        // Строка и у стены с типом: очаг можно поставить и в неё
+        const PlanMaterial& from = plan->material(x, y, z);
+        if (from.typeIndex < 0) continue;
+        fresh->present[local >> 6] |= (std::uint64_t)1 << (local & 63);
+
+        std::uint32_t bits = 0;
+        for (std::size_t k = 0; k < Stencil::FOOTPRINT_COUNT; k++) {
+            const StencilOffset& offset = Stencil::FOOTPRINT[k];
+            int nx = x + offset.dx, ny = y + offset.dy, nz = z + offset.dz;
+            if (!grid->inside(nx, ny, nz) || !plan->passable(nx, ny, nz)) continue;
+            if (edgeWeight(from, plan->material(nx, ny, nz), offset.dz) > 0) bits |= (std::uint32_t)1 << k;
+        }
+        fresh->bits.push_back(bits);
+        if (!weighted) continue;
+
+        std::int32_t rowOf = -1;
+        if (from.passable) {
+            bool uniform = true;
+            row.clear();
+            for (std::size_t k = 0; k < Stencil::FOOTPRINT_COUNT; k++) {
+                const StencilOffset& offset = Stencil::FOOTPRINT[k];
+                int nx = x + offset.dx, ny = y + offset.dy, nz = z + offset.dz;
+                if (!grid->inside(nx, ny, nz)) continue;
+                // Ребро от соседа к клетке идёт в обратную сторону
+                float weight = edgeWeight(plan->material(nx, ny, nz), from, -offset.dz);
+                uniform = uniform && weight == 1;
+                int nonzero = (offset.dx != 0) + (offset.dy != 0) + (offset.dz != 0);
+                if (weight > 0) row.push_back(WeightedLink{(std::int32_t)k, weight * (nonzero == Stencil::DIMENSIONS ? 1 : 2)});
+            }
+            if (!uniform) {
+                if (fresh->rowStart.empty()) fresh->rowStart.push_back(0);
+                rowOf = (std::int32_t)(fresh->rowStart.size() - 1);
+                fresh->links.insert(fresh->links.end(), row.begin(), row.end());
+                fresh->rowStart.push_back((std::uint32_t)fresh->links.size());
+            }
+        }
+        fresh->rowOf.push_back(rowOf);
+    }
+
+    const AdjacencyBrick* brick = fresh;
+    if (fresh->bits.empty()) {
+        delete fresh;
+        brick = &AdjacencyTable::empty();
+    } else {
+        int rows = 0;
+        for (int word = 0; word < AdjacencyBrick::WORDS; word++) {
+            fresh->before[word] = (std::uint16_t)rows;
+            for (std::uint64_t rest = fresh->present[word]; rest != 0; rest &= rest - 1) rows++;
+        }
+        // Взвешенных строк в брике нет - rowOf не нужен
+        if (fresh->rowStart.empty()) fresh->rowOf.clear();
+    }
+
+    const AdjacencyBrick* installed = installBrick(bricks[tile], brick);
+    if (installed != brick && brick != &AdjacencyTable::empty()) delete brick;
+    return *installed;
+}
+
+#endif // CELLADJACENCY_H
@@ -0,0 +1,132 @@
+#include "Checkpoint.h"
+#include <cstdio>
+#include <cstring>
+#include "FireSimulation.h"
+
+// Тайл VoxelGrid не больше 8x8x8 клеток
+const std::uint32_t MAX_TILE_CELLS = 512;
+
+static std::uint64_t padded(std::uint64_t bytes) {
+    return (bytes + 7) & ~(std::uint64_t)7;
+}
+
+// Раздел с дополнением нулями до 8 байт
+static void writeSection(FILE* file, const void* data, std::uint64_t bytes) {
+    if (bytes > 0) fwrite(data, 1, (std::size_t)bytes, file);
+    static const char zeros[8] = {0};
+    std::uint64_t pad = padded(bytes) - bytes;
+    if (pad > 0) fwrite(zeros, 1, (std::size_t)pad, file);
+}
+
+CheckpointState::CheckpointState() {
+    memset(&header, 0, sizeof(header));
+}
+
+// Точку может отображать и сам записывающий движок, если продолжает с
+// этого же файла, поэтому она заменяется через MappedFile::replace
+bool CheckpointState::write(const char* path) const {
+    std::string temporary = MappedFile::temporaryPath(path);
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    CheckpointHeader out = header;
+    out.magic = CHECKPOINT_MAGIC;
+    out.version = CHECKPOINT_VERSION;
+    out.cellCount = cells.size();
+    out.checkCount = checkList.size();
+    out.newCount = newList.size();
+    out.fireCount = fireList.size();
+    out.dueCount = calendar.size();
+    fwrite(&out, sizeof(out), 1, file);
+    writeSection(file, tileStart.data(), tileStart.size() * sizeof(std::uint64_t));
+    writeSection(file, cells.data(), cells.size() * sizeof(CheckpointCell));
+    writeSection(file, checkList.data(), checkList.size() * sizeof(CellIndex));
+    if (out.eventDriven) writeSection(file, igniteSteps.data(), igniteSteps.size() * sizeof(std::int32_t));
+    writeSection(file, newList.data(), newList.size() * sizeof(CellIndex));
+    writeSection(file, fireList.data(), fireList.size() * sizeof(CellIndex));
+    writeSection(file, calendar.data(), calendar.size() * sizeof(CheckpointDue));
+    bool written = !ferror(file);
+    if (fclose(file) != 0 || !written) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return MappedFile::replace(temporary.c_str(), path);
+}
+
+std::shared_ptr<const Checkpoint> Checkpoint::load(const char* path) {
+    std::shared_ptr<Checkpoint> checkpoint(new Checkpoint());
+    if (!checkpoint->open(path)) return nullptr;
+    return checkpoint;
+}
+
+bool Checkpoint::open(const char* path) {
+    if (!file.open(path, false)) return false;
+    const std::uint8_t* base = (const std::uint8_t*)file.data();
+    std::uint64_t size = file.size();
+    if (!base || size < sizeof(CheckpointHeader)) return false;
+    fileHeader = (const CheckpointHeader*)base;
+    if (fileHeader->magic != CHECKPOINT_MAGIC || fileHeader->version != CHECKPOINT_VERSION) return false;
+
+    // Размеры разделов по счётчикам заголовка; файл должен быть ровно такой длины.
+    // Счётчики сначала ограничиваются размером файла, чтобы умножение
+    // и сумма разделов не переполнились
+    const CheckpointHeader& h = *fileHeader;
+    if (h.tileCount >= size / sizeof(std::uint64_t) || h.cellCount > size / sizeof(CheckpointCell) ||
+        h.checkCount > size / sizeof(CellIndex) || h.newCount > size / sizeof(CellIndex) ||
+        h.fireCount > size / sizeof(CellIndex) || h.dueCount > size / sizeof(CheckpointDue)) {
+        return false;
+    }
+    std::uint64_t sections[] = {
+        padded((h.tileCount + 1) * sizeof(std::uint64_t)),
+        padded(h.cellCount * sizeof(CheckpointCell)),
+        padded(h.checkCount * sizeof(CellIndex)),
+        h.eventDriven ? padded(h.checkCount * sizeof(std::int32_t)) : 0,
+        padded(h.newCount * sizeof(CellIndex)),
+        padded(h.fireCount * sizeof(CellIndex)),
+        padded(h.dueCount * sizeof(CheckpointDue)),
+    };
+    std::uint64_t offsets[7];
+    std::uint64_t offset = sizeof(CheckpointHeader);
+    for (int i = 0; i < 7; i++) {
+        offsets[i] = offset;
+        offset += sections[i];
+    }
+    if (offset != size) return false;
+
+    tileStart = (const std::uint64_t*)(base + offsets[0]);
+    cellData = (const CheckpointCell*)(base + offsets[1]);
+    checkData = (const CellIndex*)(base + offsets[2]);
+    igniteData = h.eventDriven ? (const std::int32_t*)(base + offsets[3]) : nullptr;
+    newData = (const CellIndex*)(base + offsets[4]);
+    fireData = (const CellIndex*)(base + offsets[5]);
+    dueData = (const CheckpointDue*)(base + offsets[6]);
+    return valid();
+}
+
+// Все индексы внутри сетки и внутри тайла, состояния клеток известные:
+// движок обращается по ним без проверок
+bool Checkpoint::valid() const {
+    const CheckpointHeader& h = *fileHeader;
+    if (h.cellsPerTile == 0 || h.cellsPerTile > MAX_TILE_CELLS) return false;
+    CellIndex cellCount = (CellIndex)h.tileCount * h.cellsPerTile;
+    if (tileStart[0] != 0 || tileStart[h.tileCount] != h.cellCount) return false;
+    for (std::uint64_t tile = 0; tile < h.tileCount; tile++) {
+        if (tileStart[tile] > tileStart[tile + 1]) return false;
+        for (std::uint64_t i = tileStart[tile]; i < tileStart[tile + 1]; i++) {
+            const CheckpointCell& cell = cellData[i];
+            if (cell.local >= h.cellsPerTile || (cell.state != BURNING && cell.state != BURNT)) return false;
+        }
+    }
+    auto inside = [cellCount](CheckpointSpan<CellIndex> list) {
+        for (CellIndex cell : list) {
+            if (cell < 0 || cell >= cellCount) return false;
+        }
+        return true;
+    };
+    if (!inside(checkList()) || !inside(newList()) || !inside(fireList())) return false;
+    for (const CheckpointDue& entry : calendar()) {
+        if (entry.cell < 0 || entry.cell >= cellCount) return false;
+    }
+    return true;
+}
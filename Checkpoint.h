@@ -0,0 +1,134 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FrontierSet.h"
+#include "MappedFile.h"
+
+// Контрольная точка прогона: всё, от чего зависит продолжение счёта.
+//
+// Файл: CheckpointHeader, затем разделы, каждый выровнен на 8 байт:
+//   tileStart   uint64 [tileCount + 1] - начало клеток тайла в cells
+//   cells       CheckpointCell [cellCount] - не EMPTY клетки по тайлам
+//   checkList   int64 [checkCount]; igniteSteps int32 [checkCount] - только событийный движок
+//   newList     int64 [newCount]
+//   fireList    int64 [fireCount]
+//   calendar    CheckpointDue [dueCount] - по корзинам, в порядке постановки
+// Списки фронта лежат в своём порядке, поэтому продолжение совпадает с
+// непрерывным прогоном до последнего бита. Генератор счётчиковый, его
+// состояние - только seed; запас топлива задаётся планом, выгоревшая масса -
+// временем горения. Индексы клеток - индексы VoxelGrid, раскладка тайлов
+// зависит только от размеров сетки.
+//
+// Файл читается без копирования (MappedFile), клетки тайла находятся по
+// tileStart, поэтому движок накладывает их на брик при первом обращении к нему.
+
+const std::uint32_t CHECKPOINT_MAGIC = 0x50435346; // "FSCP"
+const std::uint32_t CHECKPOINT_VERSION = 2;
+
+struct CheckpointHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t height;
+    std::uint32_t width;
+    std::uint32_t depth;
+    std::uint32_t dimensions;      // Stencil::DIMENSIONS движка
+    std::uint64_t seed;
+    std::int32_t step;             // шагов сделано
+    std::uint32_t eventDriven;
+    std::int64_t burntCount;
+    std::uint64_t tileCount;
+    std::uint32_t cellsPerTile;
+    std::uint32_t calendarBuckets;
+    std::uint64_t cellCount;
+    std::uint64_t checkCount;
+    std::uint64_t newCount;
+    std::uint64_t fireCount;
+    std::uint64_t dueCount;
+};
+
+// local - клетка внутри тайла (тайл не больше 512 клеток); burnTime - время
+// горения t у выгоревшей клетки, у горящей 0
+struct CheckpointCell {
+    std::int32_t burnTime;
+    std::int32_t burnStart;
+    std::uint16_t local;
+    std::uint8_t state;
+    std::uint8_t reserved;
+};
+
+struct CheckpointDue {
+    std::int64_t cell;
+    std::int32_t due;
+    std::int32_t reserved;
+};
+
+// Участок раздела без копирования
+template <class T>
+struct CheckpointSpan {
+    const T* first;
+    const T* last;
+    const T* begin() const { return first; }
+    const T* end() const { return last; }
+    std::size_t size() const { return (std::size_t)(last - first); }
+    const T& operator[](std::size_t i) const { return first[i]; }
+};
+
+// Состояние для записи; собирает FireEngine::saveCheckpoint
+struct CheckpointState {
+    CheckpointHeader header;
+    std::vector<std::uint64_t> tileStart;
+    std::vector<CheckpointCell> cells;
+    std::vector<CellIndex> checkList;
+    std::vector<std::int32_t> igniteSteps;
+    std::vector<CellIndex> newList;
+    std::vector<CellIndex> fireList;
+    std::vector<CheckpointDue> calendar;
+
+    CheckpointState();
+    bool write(const char* path) const;
+};
+
+// Загруженная контрольная точка, только для чтения. Один экземпляр можно
+// отдать любому числу движков (shared_ptr): отображённые страницы общие,
+// каждый движок копирует к себе только брики, которых касается
+class Checkpoint {
+public:
+    // nullptr, если файл не открылся или повреждён
+    static std::shared_ptr<const Checkpoint> load(const char* path);
+
+    Checkpoint(const Checkpoint&) = delete;
+    Checkpoint& operator=(const Checkpoint&) = delete;
+
+    const CheckpointHeader& header() const { return *fileHeader; }
+    // Клетки тайла tile
+    CheckpointSpan<CheckpointCell> tile(CellIndex tile) const {
+        return CheckpointSpan<CheckpointCell>{cellData + tileStart[tile], cellData + tileStart[tile + 1]};
+    }
+    CheckpointSpan<CellIndex> checkList() const { return CheckpointSpan<CellIndex>{checkData, checkData + fileHeader->checkCount}; }
+    // Шаги загорания кандидатов checkList, nullptr без событийного движка
+    const std::int32_t* igniteSteps() const { return igniteData; }
+    CheckpointSpan<CellIndex> newList() const { return CheckpointSpan<CellIndex>{newData, newData + fileHeader->newCount}; }
+    CheckpointSpan<CellIndex> fireList() const { return CheckpointSpan<CellIndex>{fireData, fireData + fileHeader->fireCount}; }
+    CheckpointSpan<CheckpointDue> calendar() const { return CheckpointSpan<CheckpointDue>{dueData, dueData + fileHeader->dueCount}; }
+
+private:
+    Checkpoint() {}
+    bool open(const char* path);
+    bool valid() const;
+
+    MappedFile file;
+    const CheckpointHeader* fileHeader = nullptr;
+    const std::uint64_t* tileStart = nullptr;
+    const CheckpointCell* cellData = nullptr;
+    const CellIndex* checkData = nullptr;
+    const std::int32_t* igniteData = nullptr;
+    const CellIndex* newData = nullptr;
+    const CellIndex* fireData = nullptr;
+    const CheckpointDue* dueData = nullptr;
+};
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,63 @@
+#ifndef COUNTERRNG_H
+#define COUNTERRNG_H
+
+#include <cstdint>
+
+// Счётчиковый генератор Philox4x32-10 (Salmon et al., SC'11).
+// Число для клетки вычисляется из (seed, шаг, индекс клетки, поток) без
+// общего состояния, поэтому его можно получить в любом потоке и в любом
+// порядке, а прогон повторяется по одному seed.
+class CounterRng {
+public:
+    explicit CounterRng(std::uint64_t seed = 0) : key(seed) {}
+
+    std::uint64_t seed() const { return key; }
+    void setSeed(std::uint64_t seed) { key = seed; }
+
+    // 128 случайных бит для счётчика (step, cell, stream)
+    void block(std::uint64_t step, std::uint64_t cell, std::uint32_t stream, std::uint32_t out[4]) const {
+        std::uint32_t c0 = (std::uint32_t)cell;
+        std::uint32_t c1 = (std::uint32_t)(cell >> 32);
+        std::uint32_t c2 = (std::uint32_t)step;
+        std::uint32_t c3 = stream ^ (std::uint32_t)(step >> 32);
+        std::uint32_t k0 = (std::uint32_t)key;
+        std::uint32_t k1 = (std::uint32_t)(key >> 32);
+
+        for (int round = 0; round < 10; round++) {
+            std::uint64_t p0 = (std::uint64_t)M0 * c0;
+            std::uint64_t p1 = (std::uint64_t)M1 * c2;
+            std::uint32_t n0 = (std::uint32_t)(p1 >> 32) ^ c1 ^ k0;
+            std::uint32_t n1 = (std::uint32_t)p1;
+            std::uint32_t n2 = (std::uint32_t)(p0 >> 32) ^ c3 ^ k1;
+            std::uint32_t n3 = (std::uint32_t)p0;
+            c0 = n0;
+            c1 = n1;
+            c2 = n2;
+            c3 = n3;
+            k0 += W0;
+            k1 += W1;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    // Равномерное число в [0, 1) с 53 значащими битами
+    double uniform(std::uint64_t step, std::uint64_t cell, std::uint32_t stream = 0) const {
+        std::uint32_t r[4];
+        block(step, cell, stream, r);
+        std::uint64_t bits = ((std::uint64_t)r[0] << 32) | r[1];
+        return (double)(bits >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    static const std::uint32_t M0 = 0xD2511F53u;
+    static const std::uint32_t M1 = 0xCD9E8D57u;
+    static const std::uint32_t W0 = 0x9E3779B9u;
+    static const std::uint32_t W1 = 0xBB67AE85u;
+
+    std::uint64_t key;
+};
+
+#endif // COUNTERRNG_H
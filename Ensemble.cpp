@@ -0,0 +1,189 @@
+#include "Ensemble.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "BrickSlot.h"
+#include "CounterRng.h"
+#include "ThreadPool.h"
+
+Ensemble::Ensemble() {}
+
+Ensemble::~Ensemble() {
+    release();
+}
+
+Ensemble::BrickStats::BrickStats(int cells, int bins)
+    : ignitions(new std::atomic<std::uint32_t>[cells]()),
+      arrivalSum(new std::atomic<std::uint64_t>[cells]()),
+      arrivalHistogram(new std::atomic<std::uint32_t>[(std::size_t)cells * bins]()),
+      burntMassSum(new std::atomic<std::uint64_t>[cells]()) {}
+
+static int brickShift(int size, int maxShift) {
+    int shift = 0;
+    while (shift < maxShift && (1 << shift) < size) shift++;
+    return shift;
+}
+
+void Ensemble::release() {
+    for (CellIndex b = 0; b < brickCount; b++) delete bricks[b].load(std::memory_order_relaxed);
+    bricks.reset();
+    brickCount = 0;
+}
+
+// Брик статистики заводится при первом обращении (installBrick)
+Ensemble::BrickStats& Ensemble::touch(int x, int y, int z) {
+    std::atomic<BrickStats*>& slot = bricks[brickOf(x, y, z)];
+    BrickStats* stats = slot.load(std::memory_order_acquire);
+    if (stats) return *stats;
+    BrickStats* fresh = new BrickStats(1 << (sx + sy + sz), bins);
+    stats = installBrick(slot, fresh);
+    if (stats != fresh) delete fresh;
+    return *stats;
+}
+
+bool Ensemble::run(const EnsembleOptions& options, const Setup& setup) {
+    FireSimulation probe;
+    setup(probe);
+    if (!probe.prepareBuilding()) return false;
+    height = probe.getHeight();
+    width = probe.getWidth();
+    depth = probe.getDepth();
+    bins = std::max(1, options.arrivalBins);
+    binWidth = std::max(1, options.binWidth);
+    realizations = 0;
+
+    release();
+    sx = brickShift(height, MAX_BRICK_SHIFT);
+    sy = brickShift(width, MAX_BRICK_SHIFT);
+    sz = brickShift(depth, MAX_BRICK_SHIFT);
+    bricksY = (width + (1 << sy) - 1) >> sy;
+    bricksZ = (depth + (1 << sz) - 1) >> sz;
+    brickCount = (CellIndex)((height + (1 << sx) - 1) >> sx) * bricksY * bricksZ;
+    bricks.reset(new std::atomic<BrickStats*>[brickCount]());
+
+    // Seed каждого прогона выводится из baseSeed и номера прогона
+    CounterRng seeds(options.baseSeed);
+    std::atomic<int> finished(0);
+    std::atomic<bool> failed(false);
+
+    // Параллельно идут прогоны, каждый прогон считается в один поток
+    ThreadPool pool(options.concurrency);
+    pool.parallelFor(options.realizations, 1, [&](std::int64_t begin, std::int64_t end) {
+        std::vector<std::pair<CellIndex, int>> arrivals;
+        for (std::int64_t r = begin; r < end; r++) {
+            std::uint32_t bits[4];
+            seeds.block(0, (std::uint64_t)r, 0, bits);
+
+            FireSimulation simulation;
+            setup(simulation);
+            simulation.setThreadCount(1);
+            simulation.setSeed(((std::uint64_t)bits[0] << 32) | bits[1]);
+            if (!simulation.initialize()) {
+                failed = true;
+                continue;
+            }
+
+            // Клетки, загоревшиеся до контрольной точки, приходят со своим шагом загорания
+            arrivals.clear();
+            if (const std::shared_ptr<const Checkpoint>& checkpoint = simulation.getCheckpoint()) {
+                CellIndex tileCells = checkpoint->header().cellsPerTile;
+                for (CellIndex tile = 0; tile < (CellIndex)checkpoint->header().tileCount; tile++) {
+                    for (const CheckpointCell& saved : checkpoint->tile(tile)) {
+                        if (saved.state != EMPTY) arrivals.emplace_back(tile * tileCells + saved.local, saved.burnStart);
+                    }
+                }
+            }
+            // Шаг прихода - номер шага, на котором клетка загорелась (очаг - 0)
+            while (simulation.isActive() && simulation.currentStep() < options.maxSteps) {
+                int step = simulation.currentStep();
+                simulation.stepSimulation();
+                for (const CellChange& change : simulation.changedThisStep()) {
+                    if (change.state == BURNING) arrivals.emplace_back(change.index, step);
+                }
+            }
+            accumulate(simulation, arrivals);
+            simulation.finish();
+            finished++;
+        }
+    });
+
+    realizations = finished;
+    return !failed && realizations > 0;
+}
+
+// Свёртка одного прогона: только загоревшиеся клетки, O(размер пожара)
+void Ensemble::accumulate(FireSimulation& simulation, const std::vector<std::pair<CellIndex, int>>& arrivals) {
+    for (const std::pair<CellIndex, int>& arrival : arrivals) {
+        const Pixel& pixel = simulation.pixelAt(arrival.first);
+        BrickStats& stats = touch(pixel.x, pixel.y, pixel.z);
+        int k = localOf(pixel.x, pixel.y, pixel.z);
+
+        double mass = pixel.fuel_mass;
+        if (pixel.state == BURNING) mass = std::min(mass, FireSimulation::burntMass(pixel.pixel_type, simulation.burningTime(pixel)));
+
+        int bin = std::min(arrival.second / binWidth, bins - 1);
+        stats.ignitions[k].fetch_add(1, std::memory_order_relaxed);
+        stats.arrivalSum[k].fetch_add((std::uint64_t)arrival.second, std::memory_order_relaxed);
+        stats.arrivalHistogram[(std::size_t)k * bins + bin].fetch_add(1, std::memory_order_relaxed);
+        stats.burntMassSum[k].fetch_add((std::uint64_t)std::llround(mass / MASS_UNIT), std::memory_order_relaxed);
+    }
+}
+
+double Ensemble::burnProbability(int x, int y, int z) const {
+    const BrickStats* stats = find(x, y, z);
+    if (realizations == 0 || !stats) return 0;
+    return stats->ignitions[localOf(x, y, z)].load() / (double)realizations;
+}
+
+double Ensemble::meanArrival(int x, int y, int z) const {
+    const BrickStats* stats = find(x, y, z);
+    int k = localOf(x, y, z);
+    std::uint32_t count = stats ? stats->ignitions[k].load() : 0;
+    if (count == 0) return -1;
+    return stats->arrivalSum[k].load() / (double)count;
+}
+
+double Ensemble::arrivalQuantile(int x, int y, int z, double q) const {
+    const BrickStats* stats = find(x, y, z);
+    int k = localOf(x, y, z);
+    std::uint32_t count = stats ? stats->ignitions[k].load() : 0;
+    if (count == 0) return -1;
+
+    double target = q * count;
+    double cumulative = 0;
+    for (int b = 0; b < bins; b++) {
+        std::uint32_t inBin = stats->arrivalHistogram[(std::size_t)k * bins + b].load();
+        if (inBin > 0 && cumulative + inBin >= target) {
+            double fraction = (target - cumulative) / inBin;
+            return (b + fraction) * binWidth;
+        }
+        cumulative += inBin;
+    }
+    return (double)bins * binWidth;
+}
+
+double Ensemble::meanBurntMass(int x, int y, int z) const {
+    const BrickStats* stats = find(x, y, z);
+    if (realizations == 0 || !stats) return 0;
+    return stats->burntMassSum[localOf(x, y, z)].load() * MASS_UNIT / realizations;
+}
+
+bool Ensemble::writeCsv(const char* path) const {
+    FILE* out = fopen(path, "w");
+    if (!out) return false;
+    fprintf(out, "x,y,z,burn_probability,mean_arrival,arrival_p10,arrival_p50,arrival_p90,mean_burnt_mass\n");
+    for (int x = 0; x < height; x++) {
+        for (int y = 0; y < width; y++) {
+            for (int z = 0; z < depth; z++) {
+                const BrickStats* stats = find(x, y, z);
+                if (!stats || stats->ignitions[localOf(x, y, z)].load() == 0) continue;
+                fprintf(out, "%d,%d,%d,%.6f,%.3f,%.3f,%.3f,%.3f,%.6f\n", x, y, z,
+                        burnProbability(x, y, z), meanArrival(x, y, z),
+                        arrivalQuantile(x, y, z, 0.1), arrivalQuantile(x, y, z, 0.5),
+                        arrivalQuantile(x, y, z, 0.9), meanBurntMass(x, y, z));
+            }
+        }
+    }
+    fclose(out);
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "FireSimulation.h"
+
+struct EnsembleOptions {
+    int realizations = 100;
+    std::uint64_t baseSeed = 1;
+    int concurrency = 0;    // одновременных прогонов, 0 - по числу ядер
+    int maxSteps = 10000;
+    int arrivalBins = 64;   // гистограмма времени прихода огня для квантилей
+    int binWidth = 4;       // шагов в корзине, последняя корзина - всё, что позже
+};
+
+// Ансамбль Монте-Карло: N независимых прогонов одного сценария.
+// Каждый прогон по завершении сразу сворачивается в общие счётчики по клеткам
+// (целочисленные атомарные суммы), поэтому память не зависит от N, а итог не
+// зависит от порядка завершения прогонов. Счётчики заводятся по брикам
+// 8x8x8 при первом загорании в брике: память растёт с площадью пожаров, а не
+// со зданием.
+class Ensemble {
+public:
+    // Настройка сценария для каждого прогона (здание, очаг), seed ставит ансамбль
+    typedef std::function<void(FireSimulation&)> Setup;
+
+    Ensemble();
+    ~Ensemble();
+
+    Ensemble(const Ensemble&) = delete;
+    Ensemble& operator=(const Ensemble&) = delete;
+
+    bool run(const EnsembleOptions& options, const Setup& setup);
+
+    int completed() const { return realizations; }
+
+    // Статистика по клетке (x - строка, y - столбец, z - слой)
+    double burnProbability(int x, int y, int z) const;
+    // Среднее время прихода огня в шагах, -1 если клетка не загоралась
+    double meanArrival(int x, int y, int z) const;
+    // Квантиль времени прихода по загоревшимся прогонам, -1 если не загоралась
+    double arrivalQuantile(int x, int y, int z, double q) const;
+    // Средняя выгоревшая масса по всем прогонам, кг
+    double meanBurntMass(int x, int y, int z) const;
+
+    // CSV по клеткам, которые загорались хотя бы раз
+    bool writeCsv(const char* path) const;
+
+private:
+    static constexpr double MASS_UNIT = 1e-6; // кг, шаг целочисленной суммы масс
+    static constexpr int MAX_BRICK_SHIFT = 3;
+
+    // Счётчики клеток одного брика, гистограмма - bins корзин на клетку
+    struct BrickStats {
+        BrickStats(int cells, int bins);
+        std::unique_ptr<std::atomic<std::uint32_t>[]> ignitions;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> arrivalSum;
+        std::unique_ptr<std::atomic<std::uint32_t>[]> arrivalHistogram;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> burntMassSum;
+    };
+
+    CellIndex brickOf(int x, int y, int z) const {
+        return ((CellIndex)(x >> sx) * bricksY + (y >> sy)) * bricksZ + (z >> sz);
+    }
+    int localOf(int x, int y, int z) const {
+        return (((x & ((1 << sx) - 1)) << sy | (y & ((1 << sy) - 1))) << sz) | (z & ((1 << sz) - 1));
+    }
+    // Брик клетки, заводится при первом обращении (из любого потока)
+    BrickStats& touch(int x, int y, int z);
+    // nullptr, если в брике ничего не загоралось
+    const BrickStats* find(int x, int y, int z) const { return bricks[brickOf(x, y, z)].load(std::memory_order_acquire); }
+    void release();
+    void accumulate(FireSimulation& simulation, const std::vector<std::pair<CellIndex, int>>& arrivals);
+
+    int height = 0;
+    int width = 0;
+    int depth = 0;
+    int realizations = 0;
+    int bins = 0;
+    int binWidth = 1;
+
+    int sx = 0, sy = 0, sz = 0;
+    int bricksY = 0;
+    int bricksZ = 0;
+    CellIndex brickCount = 0;
+    std::unique_ptr<std::atomic<BrickStats*>[]> bricks;
+};
+
+#endif // ENSEMBLE_H
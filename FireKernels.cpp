@@ -0,0 +1,255 @@
+#include "FireKernels.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FIRE_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+// Вес окна из трёх бит (бит 0 - y-1, бит 1 - y, бит 2 - y+1) для строк окрестности:
+// угловые строки (dx != 0, dz != 0), боковые (одно из dx, dz равно 0) и своя строка
+static const std::uint8_t CORNER_WEIGHT[8] = {0, 1, 2, 3, 1, 2, 3, 4};
+static const std::uint8_t EDGE_WEIGHT[8] = {0, 2, 2, 4, 2, 4, 4, 6};
+static const std::uint8_t CENTRE_WEIGHT[8] = {0, 2, 0, 2, 2, 4, 2, 4};
+
+KernelIsa detectKernelIsa() {
+#ifdef FIRE_KERNELS_X86
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return KernelIsa::Avx512;
+    if (__builtin_cpu_supports("avx2")) return KernelIsa::Avx2;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+        bool avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)) && (xcr0 & 0xE6) == 0xE6;
+        if (avx512) return KernelIsa::Avx512;
+        if (avx2) return KernelIsa::Avx2;
+    }
+#endif
+#endif
+    return KernelIsa::Scalar;
+}
+
+const char* kernelIsaName(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::Avx512: return "avx512";
+        case KernelIsa::Avx2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+void BurningMask::reset(int height, int width, int depth, int firstX) {
+    x0 = firstX;
+    h = height;
+    w = width;
+    d = depth;
+    rowWords = (width + 63) / 64 + 2;
+    bits.assign((std::size_t)h * d * rowWords, 0);
+    zeroRow.assign(rowWords, 0);
+    rowIsa = detectKernelIsa();
+}
+
+void BurningMask::copyRow(const BurningMask& from, int x, int z) {
+    const std::uint64_t* source = from.rowOrZero(x, z);
+    std::uint64_t* target = rowAt(x, z);
+    for (int i = 0; i < rowWords; i++) target[i] = source[i];
+}
+
+static inline int window3(const std::uint64_t* row, int p) {
+    int shift = p & 63;
+    std::uint64_t value = row[p >> 6] >> shift;
+    if (shift > 61) value |= row[(p >> 6) + 1] << (64 - shift);
+    return (int)(value & 7);
+}
+
+int BurningMask::fpCell(int x, int y, int z) const {
+    int p = y + 63; // бит клетки y-1 в строке с пустым словом впереди
+    int fp = 0;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            int window = window3(rowOrZero(x + dx, z + dz), p);
+            if (dx != 0 && dz != 0) fp += CORNER_WEIGHT[window];
+            else if (dx != 0 || dz != 0) fp += EDGE_WEIGHT[window];
+            else fp += CENTRE_WEIGHT[window];
+        }
+    }
+    return fp;
+}
+
+int BurningMask::fpCellPlanar(int x, int y) const {
+    int p = y + 63;
+    return CORNER_WEIGHT[window3(rowOrZero(x - 1, 0), p)] +
+           CENTRE_WEIGHT[window3(rowOrZero(x, 0), p)] +
+           CORNER_WEIGHT[window3(rowOrZero(x + 1, 0), p)];
+}
+
+// Строчное ядро. Девять строк маски распаковываются в байты и складываются
+// в три суммы по столбцам: угловые строки, боковые и своя строка. Затем
+// fp[y] = 2C[y] + C[y-1] + C[y+1] + 2(E[y-1] + E[y] + E[y+1]) + 2(M[y-1] + M[y+1]),
+// максимум 44, поэтому все суммы помещаются в байт.
+struct RowScratch {
+    std::vector<std::uint8_t> corner;
+    std::vector<std::uint8_t> edge;
+    std::vector<std::uint8_t> centre;
+};
+
+static void unpackAddScalar(const std::uint64_t* row, int words, std::uint8_t* acc) {
+    for (int k = 0; k < words; k++) {
+        std::uint64_t word = row[k];
+        if (!word) continue;
+        for (int j = 0; j < 64; j++) acc[k * 64 + j] += (std::uint8_t)((word >> j) & 1);
+    }
+}
+
+static void combineScalar(const RowScratch& s, int width, std::uint8_t* out) {
+    const std::uint8_t* C = s.corner.data() + 64;
+    const std::uint8_t* E = s.edge.data() + 64;
+    const std::uint8_t* M = s.centre.data() + 64;
+    for (int y = 0; y < width; y++) {
+        out[y] = (std::uint8_t)(2 * C[y] + C[y - 1] + C[y + 1] + 2 * (E[y - 1] + E[y] + E[y + 1]) + 2 * (M[y - 1] + M[y + 1]));
+    }
+}
+
+#ifdef FIRE_KERNELS_X86
+
+static TARGET_AVX2 void unpackAddAvx2(const std::uint64_t* row, int words, std::uint8_t* acc) {
+    const __m256i shuffle = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                             2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_set1_epi64x((long long)0x8040201008040201ULL);
+    const __m256i one = _mm256_set1_epi8(1);
+    for (int k = 0; k < words; k++) {
+        std::uint64_t word = row[k];
+        if (!word) continue;
+        for (int half = 0; half < 2; half++) {
+            __m256i v = _mm256_set1_epi32((int)(std::uint32_t)(word >> (32 * half)));
+            v = _mm256_shuffle_epi8(v, shuffle);
+            v = _mm256_cmpeq_epi8(_mm256_and_si256(v, select), select);
+            v = _mm256_and_si256(v, one);
+            __m256i* dst = (__m256i*)(acc + k * 64 + half * 32);
+            _mm256_storeu_si256(dst, _mm256_add_epi8(_mm256_loadu_si256(dst), v));
+        }
+    }
+}
+
+static TARGET_AVX2 void combineAvx2(const RowScratch& s, int width, std::uint8_t* out) {
+    const std::uint8_t* C = s.corner.data() + 64;
+    const std::uint8_t* E = s.edge.data() + 64;
+    const std::uint8_t* M = s.centre.data() + 64;
+    int y = 0;
+    for (; y + 32 <= width; y += 32) {
+        __m256i c0 = _mm256_loadu_si256((const __m256i*)(C + y - 1));
+        __m256i c1 = _mm256_loadu_si256((const __m256i*)(C + y));
+        __m256i c2 = _mm256_loadu_si256((const __m256i*)(C + y + 1));
+        __m256i e = _mm256_add_epi8(_mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(E + y - 1)),
+                                                     _mm256_loadu_si256((const __m256i*)(E + y))),
+                                    _mm256_loadu_si256((const __m256i*)(E + y + 1)));
+        __m256i m = _mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(M + y - 1)),
+                                    _mm256_loadu_si256((const __m256i*)(M + y + 1)));
+        __m256i twice = _mm256_add_epi8(_mm256_add_epi8(c1, e), m);
+        __m256i sum = _mm256_add_epi8(_mm256_add_epi8(twice, twice), _mm256_add_epi8(c0, c2));
+        _mm256_storeu_si256((__m256i*)(out + y), sum);
+    }
+    for (; y < width; y++) {
+        out[y] = (std::uint8_t)(2 * C[y] + C[y - 1] + C[y + 1] + 2 * (E[y - 1] + E[y] + E[y + 1]) + 2 * (M[y - 1] + M[y + 1]));
+    }
+}
+
+static TARGET_AVX512 void unpackAddAvx512(const std::uint64_t* row, int words, std::uint8_t* acc) {
+    for (int k = 0; k < words; k++) {
+        std::uint64_t word = row[k];
+        if (!word) continue;
+        __m512i v = _mm512_maskz_set1_epi8((__mmask64)word, 1);
+        __m512i* dst = (__m512i*)(acc + k * 64);
+        _mm512_storeu_si512(dst, _mm512_add_epi8(_mm512_loadu_si512(dst), v));
+    }
+}
+
+static TARGET_AVX512 void combineAvx512(const RowScratch& s, int width, std::uint8_t* out) {
+    const std::uint8_t* C = s.corner.data() + 64;
+    const std::uint8_t* E = s.edge.data() + 64;
+    const std::uint8_t* M = s.centre.data() + 64;
+    int y = 0;
+    for (; y < width; y += 64) {
+        __mmask64 tail = width - y >= 64 ? ~(__mmask64)0 : (((__mmask64)1 << (width - y)) - 1);
+        __m512i c0 = _mm512_loadu_si512(C + y - 1);
+        __m512i c1 = _mm512_loadu_si512(C + y);
+        __m512i c2 = _mm512_loadu_si512(C + y + 1);
+        __m512i e = _mm512_add_epi8(_mm512_add_epi8(_mm512_loadu_si512(E + y - 1), _mm512_loadu_si512(E + y)),
+                                    _mm512_loadu_si512(E + y + 1));
+        __m512i m = _mm512_add_epi8(_mm512_loadu_si512(M + y - 1), _mm512_loadu_si512(M + y + 1));
+        __m512i twice = _mm512_add_epi8(_mm512_add_epi8(c1, e), m);
+        __m512i sum = _mm512_add_epi8(_mm512_add_epi8(twice, twice), _mm512_add_epi8(c0, c2));
+        _mm512_mask_storeu_epi8(out + y, tail, sum);
+    }
+}
+
+#endif
+
+// Строки окрестности по классам: угловые, боковые и своя строка
+static void rowKernel(const std::uint64_t* const* rows, const std::uint8_t* classes, int count,
+                      int rowWords, int width, KernelIsa isa, std::uint8_t* out) {
+    static thread_local RowScratch scratch;
+    // Байт i массивов соответствует биту i строки; бит 64 - клетка y = 0.
+    // Запас в 64 байта позволяет читать полные векторы за концом строки.
+    std::size_t length = (std::size_t)rowWords * 64 + 64;
+    scratch.corner.assign(length, 0);
+    scratch.edge.assign(length, 0);
+    scratch.centre.assign(length, 0);
+    std::uint8_t* sums[3] = {scratch.corner.data(), scratch.edge.data(), scratch.centre.data()};
+
+#ifndef FIRE_KERNELS_X86
+    isa = KernelIsa::Scalar;
+#endif
+    for (int r = 0; r < count; r++) {
+        std::uint8_t* acc = sums[classes[r]];
+#ifdef FIRE_KERNELS_X86
+        if (isa == KernelIsa::Avx512) { unpackAddAvx512(rows[r], rowWords, acc); continue; }
+        if (isa == KernelIsa::Avx2) { unpackAddAvx2(rows[r], rowWords, acc); continue; }
+#endif
+        unpackAddScalar(rows[r], rowWords, acc);
+    }
+
+#ifdef FIRE_KERNELS_X86
+    if (isa == KernelIsa::Avx512) { combineAvx512(scratch, width, out); return; }
+    if (isa == KernelIsa::Avx2) { combineAvx2(scratch, width, out); return; }
+#endif
+    combineScalar(scratch, width, out);
+}
+
+void BurningMask::fpRow(int x, int z, std::uint8_t* out) const {
+    const std::uint64_t* rows[9];
+    std::uint8_t classes[9];
+    int count = 0;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            rows[count] = rowOrZero(x + dx, z + dz);
+            classes[count++] = dx != 0 && dz != 0 ? 0 : dx != 0 || dz != 0 ? 1 : 2;
+        }
+    }
+    rowKernel(rows, classes, count, rowWords, w, rowIsa, out);
+}
+
+// На плоскости соседние строки x +- 1 весят как угловые строки объёма
+void BurningMask::fpRowPlanar(int x, std::uint8_t* out) const {
+    const std::uint64_t* rows[3] = {rowOrZero(x - 1, 0), rowOrZero(x + 1, 0), rowOrZero(x, 0)};
+    const std::uint8_t classes[3] = {0, 0, 2};
+    rowKernel(rows, classes, 3, rowWords, w, rowIsa, out);
+}
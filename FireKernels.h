@@ -0,0 +1,79 @@
+#ifndef FIREKERNELS_H
+#define FIREKERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+// Набор инструкций для строчного ядра fp
+enum class KernelIsa { Scalar, Avx2, Avx512 };
+
+// Лучший набор, поддерживаемый процессором
+KernelIsa detectKernelIsa();
+const char* kernelIsaName(KernelIsa isa);
+
+// Битовая маска горящих клеток. Строка маски - клетки (x, 0..width-1, z),
+// по биту на клетку, с пустым словом в начале и в конце строки, чтобы окно
+// y-1..y+1 читалось без проверок границ.
+//
+// fp = 2 * a + b по окрестности Мура 3x3x3: b - соседи по диагонали
+// (все три смещения ненулевые), a - все остальные.
+//
+// Маска может покрывать только строки x из [firstX, firstX + height) - кусок
+// сетки одного потока (SlabDomains.h); строки вне куска читаются как пустые.
+class BurningMask {
+public:
+    void reset(int height, int width, int depth, int firstX = 0);
+
+    void set(int x, int y, int z) {
+        std::uint64_t* row = rowAt(x, z);
+        int p = y + 64;
+        row[p >> 6] |= (std::uint64_t)1 << (p & 63);
+    }
+    void clear(int x, int y, int z) {
+        std::uint64_t* row = rowAt(x, z);
+        int p = y + 64;
+        row[p >> 6] &= ~((std::uint64_t)1 << (p & 63));
+    }
+    bool test(int x, int y, int z) const {
+        const std::uint64_t* row = rowOrZero(x, z);
+        int p = y + 64;
+        return (row[p >> 6] >> (p & 63)) & 1;
+    }
+
+    // fp одной клетки: девять строк, из каждой окно в три бита
+    int fpCell(int x, int y, int z) const;
+
+    // fp всех клеток строки (x, z), out - width байт
+    void fpRow(int x, int z, std::uint8_t* out) const;
+
+    // Плоская карта (depth = 1, окрестность 3x3): b - соседи по диагонали
+    int fpCellPlanar(int x, int y) const;
+    void fpRowPlanar(int x, std::uint8_t* out) const;
+
+    // Скопировать строку (x, z) из другой маски той же ширины
+    void copyRow(const BurningMask& from, int x, int z);
+
+    KernelIsa isa() const { return rowIsa; }
+    void setIsa(KernelIsa isa) { rowIsa = isa; }
+
+    int width() const { return w; }
+
+private:
+    std::uint64_t* rowAt(int x, int z) { return &bits[((std::size_t)(x - x0) * d + z) * rowWords]; }
+    const std::uint64_t* rowOrZero(int x, int z) const {
+        x -= x0;
+        if (x < 0 || x >= h || z < 0 || z >= d) return zeroRow.data();
+        return &bits[((std::size_t)x * d + z) * rowWords];
+    }
+
+    int x0 = 0;
+    int h = 0;
+    int w = 0;
+    int d = 0;
+    int rowWords = 0;
+    std::vector<std::uint64_t> bits;
+    std::vector<std::uint64_t> zeroRow;
+    KernelIsa rowIsa = KernelIsa::Scalar;
+};
+
+#endif // FIREKERNELS_H
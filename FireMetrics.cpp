@@ -0,0 +1,79 @@
+#include "FireMetrics.h"
+
+void FireMetrics::reset(int materialCount, int roomCount, std::size_t columns, double secondsPerStep) {
+    all = FireTotals();
+    materials.assign(materialCount, FireTotals());
+    rooms.assign(roomCount, FireTotals());
+    columnBurnt.assign(columns, 0);
+    stepSeconds = secondsPerStep;
+    current = -1;
+}
+
+void FireMetrics::clear() {
+    all = FireTotals();
+    materials.clear();
+    rooms.clear();
+    columnBurnt.clear();
+    current = -1;
+}
+
+void FireMetrics::add(FireTotals& totals, double energy, int burnStart) {
+    double b = burnStart;
+    totals.burning++;
+    totals.energy += energy;
+    totals.energyStart += energy * b;
+    totals.energyStart2 += energy * b * b;
+}
+
+void FireMetrics::remove(FireTotals& totals, double energy, int burnStart, double lastEnergy) {
+    double b = burnStart;
+    totals.burning--;
+    totals.burnt++;
+    if (totals.burning == 0) {
+        // Без горящих клеток суммы точно нулевые, ошибка округления не копится
+        totals.energy = totals.energyStart = totals.energyStart2 = 0;
+    } else {
+        totals.energy -= energy;
+        totals.energyStart -= energy * b;
+        totals.energyStart2 -= energy * b * b;
+    }
+    if (totals.retiredStep != current) {
+        totals.retiredStep = current;
+        totals.retiredEnergy = 0;
+    }
+    totals.retiredEnergy += lastEnergy;
+}
+
+void FireMetrics::ignite(int material, int room, double energy, int burnStart) {
+    add(all, energy, burnStart);
+    if (material >= 0) add(materials[material], energy, burnStart);
+    if (room >= 0) add(rooms[room], energy, burnStart);
+}
+
+void FireMetrics::burnOut(int material, int room, std::size_t column, double energy, int burnStart,
+                          double lastEnergy) {
+    bool newArea = !columnBurnt[column];
+    columnBurnt[column] = 1;
+    remove(all, energy, burnStart, lastEnergy);
+    all.burntArea += newArea;
+    if (material >= 0) {
+        remove(materials[material], energy, burnStart, lastEnergy);
+        materials[material].burntArea += newArea;
+    }
+    if (room >= 0) {
+        remove(rooms[room], energy, burnStart, lastEnergy);
+        rooms[room].burntArea += newArea;
+    }
+}
+
+// Сумма e * ((n + 1)³ - n³) = e * (3n² + 3n + 1) по горящим клеткам, n = s - b,
+// раскрыта через суммы e, e * b, e * b²
+double FireMetrics::stepHeat(const FireTotals& totals) const {
+    if (current < 0) return 0;
+    double s = current;
+    double squares = s * s * totals.energy - 2 * s * totals.energyStart + totals.energyStart2;
+    double linear = s * totals.energy - totals.energyStart;
+    double energy = 3 * squares + 3 * linear + totals.energy;
+    if (totals.retiredStep == current) energy += totals.retiredEnergy;
+    return energy;
+}
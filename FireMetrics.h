@@ -0,0 +1,64 @@
+#ifndef FIREMETRICS_H
+#define FIREMETRICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Итоги по группе клеток (всё здание, материал, помещение). Счётчики
+// обновляются при смене состояния клетки, так что шаг стоит O(изменений).
+// Клетка - 1 м³ (CELL_VOLUME), клетка плана - 1 м².
+struct FireTotals {
+    int burning = 0;             // горящих клеток
+    std::int64_t burnt = 0;      // выгоревших клеток, объём в клетках
+    std::int64_t burntArea = 0;  // клеток плана этажа, над которыми выгорела хоть одна клетка
+
+    // Теплота горящих клеток: клетка, загоревшаяся на шаге b, выделяет на
+    // шаге s энергию e * ((n + 1)³ - n³), n = s - b. Суммы e, e * b, e * b²
+    // дают теплоту шага без обхода клеток
+    double energy = 0;
+    double energyStart = 0;
+    double energyStart2 = 0;
+    // Теплота клеток, догоревших на шаге retiredStep (их уже нет в суммах)
+    double retiredEnergy = 0;
+    int retiredStep = -1;
+};
+
+class FireMetrics {
+public:
+    // columns - клеток плана по всем этажам (этажи * height * width)
+    void reset(int materials, int rooms, std::size_t columns, double secondsPerStep);
+    void clear();
+
+    // Клетка загорелась; burnStart - первый шаг горения, energy - см. FireTotals.
+    // material, room: -1 - не считать в этой группе
+    void ignite(int material, int room, double energy, int burnStart);
+    // Шаг, для которого считается мощность; до догорания клеток этого шага
+    void beginStep(int step) { current = step; }
+    // Клетка догорела: текущий шаг был последним шагом её горения, за него
+    // выделилось lastEnergy кДж. column - клетка плана этажа
+    void burnOut(int material, int room, std::size_t column, double energy, int burnStart, double lastEnergy);
+
+    const FireTotals& total() const { return all; }
+    int materialCount() const { return (int)materials.size(); }
+    const FireTotals& material(int id) const { return materials[id]; }
+    int roomCount() const { return (int)rooms.size(); }
+    const FireTotals& room(int id) const { return rooms[id]; }
+    // Теплота, выделившаяся в группе на последнем шаге, кДж
+    double stepHeat(const FireTotals& totals) const;
+    // Мощность тепловыделения группы на последнем шаге, кВт
+    double heatRelease(const FireTotals& totals) const { return stepHeat(totals) / stepSeconds; }
+
+private:
+    void add(FireTotals& totals, double energy, int burnStart);
+    void remove(FireTotals& totals, double energy, int burnStart, double lastEnergy);
+
+    FireTotals all;
+    std::vector<FireTotals> materials;
+    std::vector<FireTotals> rooms;
+    std::vector<std::uint8_t> columnBurnt; // над клеткой плана уже что-то выгорело
+    double stepSeconds = 1;
+    int current = -1;
+};
+
+#endif // FIREMETRICS_H
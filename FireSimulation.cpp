@@ -2,10 +2,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
-#include <windows.h>
-#include <iostream>
-#include "rapidjson/document.h"
-#include "rapidjson/filereadstream.h"
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include "FrameRecorder.h"
+#include "StepPipeline.h"
 
 const int START_FIRE_X = 11;
 const int START_FIRE_Y = 5;
@@ -49,286 +54,1346 @@ const char * MAP = "\
 ####################################################################################################";
 
 
-FireSimulation::FireSimulation() {
-    srand(time(NULL));
-}
-
-FireSimulation::~FireSimulation() {
-    // Освобождение ресурсов, если надо будет
-}
-
-PixelType* FireSimulation::loadData() {
-    FILE* fp = fopen(JSON_FILE_PATH, "r");
-    if (!fp) {
-        printf("Ошибка при считывании файла: %s\n", strerror(errno));
-        return nullptr;
-    }
-
-    char readBuffer[40000];
-    rapidjson::FileReadStream is(fp, readBuffer, sizeof(readBuffer));
-
-    rapidjson::Document d;
-    d.ParseStream(is);
-
-    fclose(fp);
-
-    int numElements = d.Size();
-    PixelType* data = new PixelType[numElements];
-
-    for (int i = 0; i < numElements; i++) {
-        const rapidjson::Value& obj = d[i];
-        data[i].Name = obj["Name"].GetString();
-        data[i].LowestHeatOfCombustion_kJ_per_kg = obj["LowestHeatOfCombustion_kJ_per_kg"].GetDouble();
-        data[i].LinearFlameSpeed = obj["LinearFlameSpeed"].GetDouble();
-        data[i].BurningRate = obj["BurningRate"].GetDouble();
-        data[i].SmokeGeneration = obj["SmokeGeneration"].GetDouble();
-        data[i].OxygenConsumption_kg_per_kg = obj["OxygenConsumption_kg_per_kg"].GetDouble();
-
-        const rapidjson::Value& gasEmission = obj["GasEmission"];
-        data[i].GasEmission.CarbonDioxide_kg_per_kg = gasEmission["CarbonDioxide_kg_per_kg"].GetDouble();
-        data[i].GasEmission.CarbonMonoxide_kg_per_kg = gasEmission["CarbonMonoxide_kg_per_kg"].GetDouble();
-        data[i].GasEmission.HydrogenChloride_kg_per_kg = gasEmission["HydrogenChloride_kg_per_kg"].GetDouble();
-    }
-
-    return data;
-}
-
-void FireSimulation::initializePixels(const char room[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH], Pixel pixels[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH]) {
-    for (int i = 0; i < ROOM_HEIGHT; i++) {
-        for (int j = 0; j < ROOM_WIDTH; j++) {
-            for (int k = 0; k < ROOM_DEPTH; k++) {
-                char current_char = room[i][j][k];
-                if (current_char == ' ') current_char = 'f';
-                const PixelType* type = pixelDataMap[current_char];
-                pixels[i][j][k].state = 0;
-                pixels[i][j][k].fp = 0;
-                pixels[i][j][k].x = i;
-                pixels[i][j][k].y = j;
-                pixels[i][j][k].pixel_type = type;
-                pixels[i][j][k].t = 0;
-                double fuel_mass = 5.0;
-                switch (room[i][j][k]) {
-                    case 't':
-                        fuel_mass = 5;
-                        break;
-                    case 'd':
-                        fuel_mass = 10;
-                        break;
-                    case '#':
-                        fuel_mass = 200;
-                        break;
-                    case 'm':
-                        fuel_mass = 20;
-                        break;
-                    case ' ':
-                        fuel_mass = 50;
-                        break;
-                    default:
-                        break;
-                }
-                pixels[i][j][k].fuel_mass = fuel_mass;
-            }
+template <class Stencil>
+FireEngine<Stencil>::FireEngine() {
+    rng.setSeed(((std::uint64_t)std::random_device()() << 32) ^ (std::uint64_t)time(NULL));
+}
+
+template <class Stencil>
+FireEngine<Stencil>::~FireEngine() {
+    finish();
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setMaterials(const char* path) {
+    materialsPath = path ? path : DEFAULT_MATERIALS_PATH;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setBuilding(const char* plan, int height, int width, int depth) {
+    this->plan = plan;
+    this->height = height;
+    this->width = width;
+    this->depth = depth;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setFloorPlan(const char* path) {
+    planPath = path ? path : "";
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setStartFire(int x, int y, int z) {
+    startFireX = x;
+    startFireY = y;
+    startFireZ = z;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setTileStore(const char* path) {
+    tileStorePath = path ? path : "";
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setSmoke(bool smoke) {
+    smokeModel = smoke;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setChangeLog(const char* path) {
+    changeLogPath = path ? path : "";
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setMetrics(bool enabled) {
+    metricsModel = enabled;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setProfile(const char* csvPath, const char* tracePath) {
+    profileCsvPath = csvPath ? csvPath : "";
+    profileTracePath = tracePath ? tracePath : "";
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setStateBuffer(bool enabled) {
+    keepStates = enabled;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setThreadCount(int threads) {
+    threadCount = threads;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setSeed(std::uint64_t seed) {
+    rng.setSeed(seed);
+    seedFixed = true;
+}
+
+template <class Stencil>
+std::uint64_t FireEngine<Stencil>::getSeed() const {
+    return rng.seed();
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setCheckpoint(const std::shared_ptr<const Checkpoint>& checkpoint) {
+    this->checkpoint = checkpoint;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setSparseBricks(bool sparse) {
+    sparseBricks = sparse;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setEventDriven(bool events) {
+    eventDriven = events;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setSlabDomains(bool slabs) {
+    slabDomains = slabs;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setZoneModel(bool zones) {
+    zoneModel = zones;
+}
+
+// Заполнение одного тайла (брика) по плану здания
+template <class Stencil>
+void FireEngine<Stencil>::initializeTile(CellIndex tile, Pixel* cells) {
+    CellIndex first = tile * pixels.cellsPerTile();
+    for (int local = 0; local < pixels.cellsPerTile(); local++) {
+        int i, j, k;
+        pixels.coords(first + local, i, j, k);
+        if (!pixels.inside(i, j, k)) {
+            cells[local] = Pixel();
+            continue;
         }
+
+        int material = floorPlan.materialAt(i, j, k);
+        Pixel& pixel = cells[local];
+        pixel.state = 0;
+        pixel.fp = 0;
+        pixel.x = i;
+        pixel.y = j;
+        pixel.z = k;
+        pixel.pixel_type = materialTypes[material];
+        pixel.t = 0;
+        pixel.burnStart = 0;
+        pixel.fuel_mass = floorPlan.materials()[material].fuelMass;
+        // Брик выгоревшего помещения создаётся заново: t восстанавливается по топливу
+        if (releasedBurnt(first + local)) {
+            pixel.state = BURNT;
+            pixel.t = TIME_SPEED * burnOutSteps(pixel);
+        }
+    }
+    // Поверх плана - клетки контрольной точки
+    if (!checkpoint) return;
+    for (const CheckpointCell& saved : checkpoint->tile(tile)) {
+        Pixel& pixel = cells[saved.local];
+        pixel.state = saved.state;
+        pixel.burnStart = saved.burnStart;
+        if (saved.state != BURNING) pixel.t = saved.burnTime;
+    }
+}
+
+// Заполняем сетку по тайлам: при хранении в файле в памяти одновременно только один тайл.
+// При разбиении на слои тайлы слоя заполняет его поток (первое касание памяти)
+template <class Stencil>
+void FireEngine<Stencil>::initializePixels() {
+    if (slabDomains && !pixels.isOutOfCore()) {
+        pool->forEachWorker([this](int worker) {
+            if (worker >= domains.count()) return;
+            CellIndex first = pixels.tileOf(pixels.index(domains.begin(worker), 0, 0));
+            CellIndex last = domains.end(worker) < height ? pixels.tileOf(pixels.index(domains.end(worker), 0, 0))
+                                                          : pixels.tileCount();
+            for (CellIndex tile = first; tile < last; tile++) {
+                initializeTile(tile, &pixels[tile * pixels.cellsPerTile()]);
+            }
+        });
+        return;
+    }
+    for (CellIndex tile = 0; tile < pixels.tileCount(); tile++) {
+        initializeTile(tile, &pixels[tile * pixels.cellsPerTile()]);
+        pixels.releaseTile(tile);
     }
 }
 
-// TODO когда буду переносить на UE сделать норм вывод
-void FireSimulation::displayRoom(Pixel pixels[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH], char char_room[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH]) {
-    for (int i = 0; i < ROOM_HEIGHT; i++) {
-        for (int j = 0; j < ROOM_WIDTH; j++) {            
-            if(pixels[i][j][0].state == BURNING){
-                std::cout << '*';                
-            } else if(pixels[i][j][0].state == EMPTY){
-                std::cout << char_room[i][j][0];
-            } else if(pixels[i][j][0].state == BURNT){
-                std::cout << 'X';
+// Кадр (слой z = 0) собирается в строку и пишется одним вызовом
+template <class Stencil>
+void FireEngine<Stencil>::displayRoom(FILE* out) {
+    frame.clear();
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            const Pixel& pixel = pixels.at(i, j, 0);
+            if(pixel.state == BURNING){
+                frame += '*';
+            } else if(pixel.state == EMPTY){
+                frame += floorPlan.symbolAt(i, j, 0);
+            } else if(pixel.state == BURNT){
+                frame += 'X';
             }   
         }
-        std::cout << std::endl;
+        frame += '\n';
     }
+    fwrite(frame.data(), 1, frame.size(), out);
 }
 
-int FireSimulation::calculateFP(Pixel pixels[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH], int x, int y, int z) {
-    int a = 0;
-    int b = 0;
+// Загоревшиеся и догоревшие за последний шаг
+template <class Stencil>
+void FireEngine<Stencil>::countChanges(int& ignited, int& burntOut) const {
+    ignited = 0;
+    burntOut = 0;
+    for (const CellChange& change : changedCells) {
+        if (change.state == BURNING) ignited++;
+        else if (change.state == BURNT) burntOut++;
+    }
+}
 
-    // Проверяем соседние пиксели по горизонтали, вертикали и в глубину
-    for (int dx = -1; dx <= 1; dx++) {
-        for (int dy = -1; dy <= 1; dy++) {
-            for (int dz = -1; dz <= 1; dz++) {
-                // Пропускаем центральный пиксель
-                if (dx == 0 && dy == 0 && dz == 0) continue;
+// Изменения последнего шага с координатами клеток - в конец out
+template <class Stencil>
+void FireEngine<Stencil>::collectUpdates(std::vector<CellUpdate>& out) const {
+    for (const CellChange& change : changedCells) {
+        CellUpdate update;
+        pixels.coords(change.index, update.x, update.y, update.z);
+        update.state = change.state;
+        out.push_back(update);
+    }
+}
 
-                int newX = x + dx;
-                int newY = y + dy;
-                int newZ = z + dz;
+// 2 * a + b по битовой маске горящих клеток (FireKernels.h)
+template <class Stencil>
+int FireEngine<Stencil>::calculateFP(int x, int y, int z) {
+    return Stencil::fp(maskAt(x), x, y, z);
+}
 
-                // Проверяем, что координаты находятся в пределах комнаты
-                if (newX >= 0 && newX < ROOM_HEIGHT &&
-                    newY >= 0 && newY < ROOM_WIDTH &&
-                    newZ >= 0 && newZ < ROOM_DEPTH) {
+// fp клетки со взвешенными рёбрами: сумма вкладов горящих соседей из
+// строки CellAdjacency (вес ребра, умноженный на 2 или 1)
+template <class Stencil>
+double FireEngine<Stencil>::weightedFP(CellIndex index, int x, int y, int z) const {
+    const BurningMask& mask = maskAt(x);
+    double fp = 0;
+    for (const WeightedLink* link = adjacency.rowBegin(index); link != adjacency.rowEnd(index); link++) {
+        const StencilOffset& offset = Stencil::FOOTPRINT[link->direction];
+        if (mask.test(x + offset.dx, y + offset.dy, z + offset.dz)) fp += link->weight;
+    }
+    return fp;
+}
 
-                    // Проверяем состояние соседнего пикселя
-                    if (pixels[newX][newY][newZ].state == BURNING) {
-                        if (dx == 0 || dy == 0 || dz == 0) {
-                            a++; // Сосед по горизонтали/вертикали/глубине
-                        } else {
-                            b++; // Сосед по диагонали
-                        }
-                    }
-                }
+// При разбиении на слои у каждого слоя своя маска с призрачными строками
+template <class Stencil>
+const BurningMask& FireEngine<Stencil>::maskAt(int x) const {
+    return slabDomains ? domains.maskAt(x) : burning;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::setBurning(int x, int y, int z) {
+    if (slabDomains) domains.set(x, y, z);
+    else burning.set(x, y, z);
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::clearBurning(int x, int y, int z) {
+    if (slabDomains) domains.clear(x, y, z);
+    else burning.clear(x, y, z);
+}
+
+// Обмен призрачными строками; слои без изменившихся крайних строк ничего не копируют
+template <class Stencil>
+void FireEngine<Stencil>::exchangeHalos() {
+    if (!slabDomains || !domains.pending()) return;
+    pool->forEachWorker([this](int worker) {
+        if (worker < domains.count()) domains.exchange(worker);
+    });
+    domains.finishExchange();
+}
+
+// Оставляем в памяти только тайлы рядом с клетками фронта
+template <class Stencil>
+void FireEngine<Stencil>::releaseIdleTiles() {
+    if (!pixels.isOutOfCore()) return;
+    activeTiles.resize(pixels.tileCount());
+    for (CellIndex tile = 0; tile < pixels.tileCount(); tile++) {
+        activeTiles[tile] = activity.isActive(tile);
+    }
+    pixels.releaseTilesExcept(activeTiles);
+}
+
+// Масса, выгоревшая за время горения t (без ограничения запасом топлива):
+// burnCoefficient * t³. Куб целого t точен, как и прежний pow(t, 3)
+template <class Stencil>
+double FireEngine<Stencil>::burnCoefficient(const PixelType* type) {
+    return 1.05 * type->BurningRate * pow(type->LinearFlameSpeed, 2);
+}
+
+template <class Stencil>
+double FireEngine<Stencil>::burntMass(const PixelType* type, int t) {
+    double time = t;
+    return burnCoefficient(type) * (time * time * time);
+}
+
+template <class Stencil>
+double FireEngine<Stencil>::burntMass(const Pixel& pixel) {
+    return burntMass(pixel.pixel_type, pixel.t);
+}
+
+// У горящей клетки t не хранится, а считается от шага загорания
+template <class Stencil>
+int FireEngine<Stencil>::burningTime(const Pixel& pixel) const {
+    if (pixel.state != BURNING) return pixel.t;
+    return TIME_SPEED * (step - pixel.burnStart);
+}
+
+// Шагов горения до догорания: наименьшее k, при котором запас топлива
+// выгорает за время TIME_SPEED * k. -1 - клетка не догорит никогда.
+// Оценка через кубический корень уточняется той же формулой burntMass,
+// что проверялась раньше на каждом шаге, поэтому шаг догорания тот же.
+template <class Stencil>
+int FireEngine<Stencil>::burnOutSteps(const Pixel& pixel) {
+    const PixelType* type = pixel.pixel_type;
+    double A = 1.05 * type->BurningRate * pow(type->LinearFlameSpeed, 2);
+    if (!(A > 0)) return -1;
+    double estimate = cbrt(pixel.fuel_mass / A) / TIME_SPEED;
+    if (!(estimate < (1 << 24))) return -1;
+    int k = std::max(1, (int)ceil(estimate));
+    while (k > 1 && pixel.fuel_mass <= burntMass(type, TIME_SPEED * (k - 1))) k--;
+    while (pixel.fuel_mass > burntMass(type, TIME_SPEED * k)) k++;
+    return k;
+}
+
+// Ключ клетки для генератора не зависит от раскладки тайлов
+template <class Stencil>
+CellIndex FireEngine<Stencil>::cellKey(const Pixel& pixel) const {
+    return ((CellIndex)pixel.x * width + pixel.y) * depth + pixel.z;
+}
+
+// Обход по тайлам; в разреженном режиме несозданные брики - нетронутые клетки (EMPTY),
+// освобождённые зональной моделью - EMPTY и BURNT по битам burntCells,
+// при продолжении с контрольной точки - клетки точки
+template <class Stencil>
+void FireEngine<Stencil>::captureStates(std::vector<std::uint8_t>& states) {
+    states.assign((std::size_t)height * width * depth, EMPTY);
+    for (CellIndex tile = 0; tile < pixels.tileCount(); tile++) {
+        bool resident = !pixels.isSparse() || pixels.isTileResident(tile);
+        if (!resident && checkpoint) {
+            for (const CheckpointCell& saved : checkpoint->tile(tile)) {
+                int x, y, z;
+                pixels.coords(tile * pixels.cellsPerTile() + saved.local, x, y, z);
+                states[((std::size_t)x * width + y) * depth + z] = (std::uint8_t)saved.state;
             }
         }
+        if (!resident && burntCells.empty()) continue;
+        CellIndex first = tile * pixels.cellsPerTile();
+        for (CellIndex index = first; index < first + pixels.cellsPerTile(); index++) {
+            int x, y, z;
+            pixels.coords(index, x, y, z);
+            if (!pixels.inside(x, y, z)) continue;
+            int state = resident ? pixels[index].state : (releasedBurnt(index) ? BURNT : EMPTY);
+            states[((std::size_t)x * width + y) * depth + z] = (std::uint8_t)state;
+        }
+    }
+}
+
+// Строки маски (x, z), в которых много кандидатов, считаются строчным ядром
+// целиком; остальные кандидаты - по одной клетке. Координаты берутся из
+// индекса, сами клетки не читаются.
+template <class Stencil>
+void FireEngine<Stencil>::countRowCandidates() {
+    touchedRows.clear();
+    int count = CheckList.size();
+    for (int i = 0; i < count; i++) {
+        CellIndex index = CheckList[i];
+        if (!activity.isActive(pixels.tileOf(index))) continue;
+        int x, y, z;
+        pixels.coords(index, x, y, z);
+        std::int32_t row = (std::int32_t)((std::size_t)x * depth + z);
+        if (rowCandidates[row]++ == 0) touchedRows.push_back(row);
     }
 
-    return 2 * a + b;
+    std::int32_t rows = 0;
+    for (std::int32_t row : touchedRows) {
+        if ((std::int64_t)rowCandidates[row] * ROW_KERNEL_RATIO >= width) rowSlot[row] = rows++;
+    }
+    if (rows == 0) return;
+    rowFp.resize((std::size_t)rows * width);
+    pool->parallelFor((std::int64_t)touchedRows.size(), 16, [this](std::int64_t begin, std::int64_t end) {
+        for (std::int64_t r = begin; r < end; r++) {
+            std::int32_t row = touchedRows[r];
+            if (rowSlot[row] < 0) continue;
+            Stencil::fpRow(maskAt(row / depth), row / depth, row % depth, &rowFp[(std::size_t)rowSlot[row] * width]);
+        }
+    });
 }
 
+// Обработка CheckList. Все клетки проверяются по состоянию на начало шага,
+// решения пишутся в отдельный буфер и применяются после проверки всех клеток,
+// поэтому результат не зависит от порядка обхода и числа потоков.
+// При разбиении на слои кандидатов слоя проверяет его поток по своей маске.
+template <class Stencil>
+void FireEngine<Stencil>::igniteCandidates() {
+    FIRE_PROFILE_PHASE(profiler, PHASE_IGNITE);
+    int count = CheckList.size();
+    checkDecisions.resize(count);
+    exchangeHalos();
+    countRowCandidates();
+    auto decide = [this](std::int64_t i) {
+        CellIndex index = CheckList[(int)i];
+        // Рядом с бриком нет горящих клеток - fp = 0, соседей не читаем
+        if (!activity.isActive(pixels.tileOf(index))) {
+            checkDecisions[i] = CHECK_DROP;
+            return;
+        }
+        const Pixel& pixel = pixels[index];
+        std::int32_t slot = rowSlot[(std::size_t)pixel.x * depth + pixel.z];
+        double fp;
+        if (adjacency.isWeighted(index)) fp = weightedFP(index, pixel.x, pixel.y, pixel.z);
+        else fp = slot >= 0 ? rowFp[(std::size_t)slot * width + pixel.y] : calculateFP(pixel.x, pixel.y, pixel.z);
+        double probability = (V * fp) / FIRE_SPREAD_PROB_DIVISOR;
+        // probability *= (1.0 - pixel.pixel_type->LowestHeatOfCombustion_kJ_per_kg / MAX_LOWEST_HEAT_OF_COMBUSTION); // Уменьшаем P на основе Низшей теплоты сгорания
 
-List* FireSimulation::createList() {
-    List* list = new List;
-    list->pixels = nullptr;
-    list->size = 0;
-    return list;
+        if (probability == 0) {
+            checkDecisions[i] = CHECK_DROP;
+        } else if (rng.uniform(step, cellKey(pixel)) < probability) {
+            checkDecisions[i] = CHECK_IGNITE;
+        } else {
+            checkDecisions[i] = CHECK_KEEP;
+        }
+    };
+    if (slabDomains) {
+        for (std::vector<std::int32_t>& candidates : slabCandidates) candidates.clear();
+        for (int i = 0; i < count; i++) {
+            int x, y, z;
+            pixels.coords(CheckList[i], x, y, z);
+            slabCandidates[domains.slabOf(x)].push_back(i);
+        }
+        pool->forEachWorker([this, &decide](int worker) {
+            if (worker >= domains.count()) return;
+            for (std::int32_t i : slabCandidates[worker]) decide(i);
+        });
+    } else {
+        pool->parallelFor(count, STEP_GRAIN, [&decide](std::int64_t begin, std::int64_t end) {
+            for (std::int64_t i = begin; i < end; i++) decide(i);
+        });
+    }
+    for (std::int32_t row : touchedRows) {
+        rowCandidates[row] = 0;
+        rowSlot[row] = -1;
+    }
+
+    // С конца: erase переставляет последний (уже обработанный) элемент на место удалённого
+    for (int i = count - 1; i >= 0; i--) {
+        if (checkDecisions[i] == CHECK_KEEP) continue;
+        CellIndex index = CheckList[i];
+        CheckList.erase(index);
+        if (checkDecisions[i] == CHECK_IGNITE) igniteCell(index);
+    }
 }
 
-void FireSimulation::addToList(List* list, Pixel* pixel) {
-    list->size++;
-    list->pixels = (Pixel**)realloc(list->pixels, sizeof(Pixel*) * list->size);
-    list->pixels[list->size - 1] = pixel;
+// Загорание клетки: состояние, маска, активность бриков, в NewList
+template <class Stencil>
+void FireEngine<Stencil>::igniteCell(CellIndex index) {
+    Pixel& pixel = pixels[index];
+    pixel.state = BURNING;
+    setBurning(pixel.x, pixel.y, pixel.z);
+    activity.addBurning(pixels, pixels.tileOf(index));
+    NewList.insert(index);
+    changedCells.push_back(CellChange{index, BURNING});
+    if (zoneModel) countZoneBurning(pixel, 1);
 }
 
-void FireSimulation::removeFromList(List* list, Pixel* pixel) {
-    for (int i = 0; i < list->size; i++) {
-        if (list->pixels[i] == pixel) {
-            for (int j = i; j < list->size - 1; j++) {
-                list->pixels[j] = list->pixels[j + 1];
-            }
-            list->size--;
-            list->pixels = (Pixel**)realloc(list->pixels, sizeof(Pixel*) * list->size);
-            break;
+// Событийный шаг. Вероятность загорания кандидата p = V * fp / 4 меняется
+// только вместе с fp, поэтому вместо испытания Бернулли на каждом шаге
+// шаг загорания разыгрывается сразу по геометрическому распределению и
+// переразыгрывается, когда у соседа меняется состояние (распределение
+// без памяти, так что это то же распределение, что и у пошагового движка).
+// CheckList здесь - кандидаты с fp > 0 и назначенным шагом загорания.
+template <class Stencil>
+void FireEngine<Stencil>::stepEvents() {
+    {
+        FIRE_PROFILE_PHASE(profiler, PHASE_IGNITE);
+        while (!ignitions.empty() && ignitions.top().step <= step) {
+            IgnitionEvent event = ignitions.top();
+            ignitions.pop();
+            if (igniteAt.get(event.cell) != step) continue; // переразыграно позже
+            igniteAt.set(event.cell, -1);
+            CheckList.erase(event.cell);
+            igniteCell(event.cell);
+        }
+    }
+    expandNewFires();
+    burnOut();
+
+    // fp изменился только у соседей клеток, сменивших состояние;
+    // переразыгрывание считается фазой загорания
+    FIRE_PROFILE_PHASE(profiler, PHASE_IGNITE);
+    exchangeHalos();
+    rescheduled.clear();
+    for (const CellChange& change : changedCells) {
+        const Pixel& pixel = pixels[change.index];
+        for (const StencilOffset& offset : Stencil::FOOTPRINT) {
+            int x = pixel.x + offset.dx;
+            int y = pixel.y + offset.dy;
+            int z = pixel.z + offset.dz;
+            if (!pixels.inside(x, y, z)) continue;
+            CellIndex index = pixels.index(x, y, z);
+            if (CheckList.contains(index)) rescheduled.insert(index);
         }
     }
+    for (CellIndex index : rescheduled) scheduleIgnition(index);
 }
 
-void FireSimulation::runSimulation() {
-    srand(time(NULL));
+// Шаг загорания кандидата по текущему fp, начиная со следующего шага
+template <class Stencil>
+void FireEngine<Stencil>::scheduleIgnition(CellIndex index) {
+    const Pixel& pixel = pixels[index];
+    double fp = adjacency.isWeighted(index) ? weightedFP(index, pixel.x, pixel.y, pixel.z) : calculateFP(pixel.x, pixel.y, pixel.z);
+    double probability = (V * fp) / FIRE_SPREAD_PROB_DIVISOR;
+    if (probability == 0) {
+        CheckList.erase(index);
+        igniteAt.set(index, -1);
+        return;
+    }
+    // Число испытаний до первого успеха: 1 + floor(ln U / ln(1 - p)), U из (0, 1]
+    int trials = 1;
+    if (probability < 1) {
+        double u = 1.0 - rng.uniform(step, cellKey(pixel), 1);
+        double wait = floor(log(u) / log1p(-probability));
+        if (!(wait < (1 << 30) - step)) {
+            igniteAt.set(index, -1); // не загорится за время счёта
+            return;
+        }
+        trials += (int)wait;
+    }
+    igniteAt.set(index, step + trials);
+    ignitions.push(IgnitionEvent{step + trials, index});
+}
 
-    char char_room[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH];
+// Соседи новых очагов попадают в CheckList. Каждый кусок NewList собирает
+// кандидатов в свой буфер, буферы сливаются по порядку кусков.
+template <class Stencil>
+void FireEngine<Stencil>::expandNewFires() {
+    FIRE_PROFILE_PHASE(profiler, PHASE_EXPAND);
+    int count = NewList.size();
+    for (int i = 0; i < count; i++) {
+        Pixel& pixel = pixels[NewList[i]];
+        if (pixel.state != BURNING) {
+            pixel.state = BURNING;
+            setBurning(pixel.x, pixel.y, pixel.z);
+            activity.addBurning(pixels, pixels.tileOf(NewList[i]));
+            changedCells.push_back(CellChange{NewList[i], BURNING});
+            if (zoneModel) countZoneBurning(pixel, 1);
+        }
+    }
 
-    for (int i = 0; i < ROOM_HEIGHT; i++) {
-        for (int j = 0; j < ROOM_WIDTH; j++) {
-            for (int k = 0; k < ROOM_DEPTH; k++) {
-                char_room[i][j][k] = MAP[i * ROOM_WIDTH + j];
+    std::int64_t chunks = (count + STEP_GRAIN - 1) / STEP_GRAIN;
+    if ((std::int64_t)expansion.size() < chunks) expansion.resize(chunks);
+    burnOutDue.resize(count);
+    pool->parallelFor(count, STEP_GRAIN, [this](std::int64_t begin, std::int64_t end) {
+        std::vector<CellIndex>& found = expansion[begin / STEP_GRAIN];
+        found.clear();
+        for (std::int64_t i = begin; i < end; i++) {
+            Pixel& pixel = pixels[NewList[(int)i]];
+            // Шаг догорания известен сразу: первый шаг горения - этот
+            int steps = burnOutSteps(pixel);
+            pixel.burnStart = step;
+            burnOutDue[i] = steps < 0 ? -1 : step + steps - 1;
+            int x = pixel.x;
+            int y = pixel.y;
+            int z = pixel.z;
+
+            // Соседи по окрестности распространения: границы сетки и стены
+            // уже отброшены в строке смежности, остаётся состояние соседа
+            adjacency.forEachNeighbour(NewList[(int)i], Stencil::SPREAD_MASK, [&](int direction) {
+                const StencilOffset& offset = Stencil::FOOTPRINT[direction];
+                CellIndex newIndex = pixels.index(x + offset.dx, y + offset.dy, z + offset.dz);
+                if (pixels[newIndex].state < BURNING) found.push_back(newIndex);
+            });
+        }
+    });
+    // Повторная вставка уже стоящей в очереди клетки ничего не делает
+    for (std::int64_t c = 0; c < chunks; c++) {
+        for (CellIndex index : expansion[c]) {
+            CheckList.insert(index);
+            if (zoneModel) {
+                int x, y, z;
+                pixels.coords(index, x, y, z);
+                approachZone(x, y, z);
             }
         }
     }
 
-    PixelType* pixel_types = loadData();
+    // Перенос пикселей из NewList в FireList и в календарь догорания
+    for (int i = 0; i < count; i++) {
+        FireList.insert(NewList[i]);
+        if (smokeModel) addSmokeSource(pixels[NewList[i]]);
+        if (burnOutDue[i] >= 0) calendar.schedule(NewList[i], burnOutDue[i]);
+        if (metricsModel || zoneModel) countMetrics(pixels[NewList[i]], true);
+    }
+    NewList.clear();
+}
+
+// Догорание: только клетки из корзины календаря на этот шаг
+template <class Stencil>
+void FireEngine<Stencil>::burnOut() {
+    FIRE_PROFILE_PHASE(profiler, PHASE_BURN_OUT);
+    if (metricsModel || zoneModel) metrics.beginStep(step);
+    calendar.retire(step, [this](CellIndex index) {
+        Pixel& pixel = pixels[index];
+        if (metricsModel || zoneModel) countMetrics(pixel, false);
+        pixel.t = TIME_SPEED * (step + 1 - pixel.burnStart);
+        pixel.state = BURNT;
+        clearBurning(pixel.x, pixel.y, pixel.z);
+        activity.removeBurning(pixels, pixels.tileOf(index));
+        FireList.erase(index);
+        changedCells.push_back(CellChange{index, BURNT});
+        burntCount++;
+        if (zoneModel) countZoneBurning(pixel, -1);
+    });
+}
 
-    pixelDataMap['t'] = &pixel_types[6];
-    pixelDataMap['d'] = &pixel_types[3];
-    pixelDataMap['m'] = &pixel_types[19];
-    pixelDataMap['#'] = &pixel_types[7];
-    pixelDataMap['f'] = &pixel_types[15];
+// Горящая клетка выделяет дым и газы, пока не выгорит запас топлива;
+// выделение за шаг считает SmokeField той же формулой, что burntMass
+template <class Stencil>
+void FireEngine<Stencil>::addSmokeSource(const Pixel& pixel) {
+    if (!pixel.pixel_type) return;
+    smoke.addSource(pixel.x, pixel.y, pixel.z, pixel.burnStart, pixel.fuel_mass, burnCoefficient(pixel.pixel_type),
+                    *pixel.pixel_type);
+}
 
-    Pixel pixels[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH];
-    initializePixels(char_room, pixels);
-    // initializePixels(char_room, pixels, pixel_types);
+// Теплота, выделившаяся в клетке за шаг горения burnStep (0 - первый), кДж;
+// на последнем шаге выгорает только остаток топлива
+template <class Stencil>
+double FireEngine<Stencil>::stepEnergy(const Pixel& pixel, int burnStep) {
+    const PixelType* type = pixel.pixel_type;
+    double before = std::min(pixel.fuel_mass, burntMass(type, TIME_SPEED * burnStep));
+    double after = std::min(pixel.fuel_mass, burntMass(type, TIME_SPEED * (burnStep + 1)));
+    return (after - before) * type->LowestHeatOfCombustion_kJ_per_kg;
+}
 
-    List* CheckList = createList();
-    List* NewList = createList();
-    List* FireList = createList();
+// Загорание (ignited) или догорание клетки в итогах FireMetrics. Без запаса
+// топлива клетка считается в горящих и выгоревших, но теплоты не даёт
+template <class Stencil>
+void FireEngine<Stencil>::countMetrics(const Pixel& pixel, bool ignited) {
+    const PixelType* type = pixel.pixel_type;
+    int material = type ? registry->idOf(type) : -1;
+    int room = roomGraph.roomAt(pixel.x, pixel.y, pixel.z);
+    // Без ограничения запасом топлива клетка выделяет energy * ((n + 1)³ - n³)
+    double energy = type ? type->LowestHeatOfCombustion_kJ_per_kg * burntMass(type, TIME_SPEED) : 0;
+    if (ignited) {
+        metrics.ignite(material, room, energy, pixel.burnStart);
+        return;
+    }
+    double last = type ? stepEnergy(pixel, step - pixel.burnStart) : 0;
+    std::size_t column = ((std::size_t)floorPlan.floorOf(pixel.z) * height + pixel.x) * width + pixel.y;
+    metrics.burnOut(material, room, column, energy, pixel.burnStart, last);
+}
 
-    addToList(NewList, &pixels[START_FIRE_Y][START_FIRE_X][START_FIRE_Z]);
+template <class Stencil>
+bool FireEngine<Stencil>::releasedBurnt(CellIndex index) const {
+    return !burntCells.empty() && (burntCells[index >> 6] >> (index & 63) & 1);
+}
 
-    int step = 0;
-    while (CheckList->size > 0 || NewList->size > 0 || FireList->size > 0 && step < 100) {
-        std::cout << "STEP: " << step << "\n";
-        // Обработка CheckList
-        for (int i = 0; i < CheckList->size; i++) {
-            Pixel* pixel = CheckList->pixels[i];
-            int fp = calculateFP(pixels, pixel->x, pixel->y, pixel->z);
-            double probability = (V * fp) / FIRE_SPREAD_PROB_DIVISOR;
-            // probability *= (1.0 - CheckList->pixels[i]->pixel_type->LowestHeatOfCombustion_kJ_per_kg / MAX_LOWEST_HEAT_OF_COMBUSTION); // Уменьшаем P на основе Низшей теплоты сгорания
+template <class Stencil>
+void FireEngine<Stencil>::activateRoom(int room) {
+    ZoneStatus& zone = zones[room];
+    if (zone.state == ZONE_VOXEL) return;
+    zone.state = ZONE_VOXEL;
+    zone.quietSteps = 0;
+    zone.activatedStep = step;
+    voxelRoomIds.push_back(room);
+}
 
-            if(probability == 0){
-                removeFromList(CheckList, pixel);
-            }
-            else if (rand() / (double)RAND_MAX < probability) {
-                pixel->state = BURNING;
-                removeFromList(CheckList, pixel);
-                addToList(NewList, pixel);
+// Огонь подошёл к клетке (она стала кандидатом): её помещение, а у клетки
+// проёма - все помещения за ним, переходят на клетки
+template <class Stencil>
+void FireEngine<Stencil>::approachZone(int x, int y, int z) {
+    int room = roomGraph.roomAt(x, y, z);
+    if (room >= 0) {
+        activateRoom(room);
+        return;
+    }
+    int door = roomGraph.doorAt(x, y, z);
+    if (door < 0) return;
+    for (int neighbour : roomGraph.door(door).rooms) activateRoom(neighbour);
+}
+
+// Горящие клетки по помещениям и проёмам; загорание - тоже подход огня
+template <class Stencil>
+void FireEngine<Stencil>::countZoneBurning(const Pixel& pixel, int delta) {
+    if (delta > 0) approachZone(pixel.x, pixel.y, pixel.z);
+    int room = roomGraph.roomAt(pixel.x, pixel.y, pixel.z);
+    if (room >= 0) {
+        zones[room].burning += delta;
+        if (delta < 0) zones[room].burnt++;
+        return;
+    }
+    int door = roomGraph.doorAt(pixel.x, pixel.y, pixel.z);
+    if (door >= 0) doorBurning[door] += delta;
+}
+
+// Конец шага: горячий слой, затем затихшие и остывшие помещения
+// сворачиваются до зонального уровня
+template <class Stencil>
+void FireEngine<Stencil>::updateZones() {
+    exchangeZoneHeat();
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < voxelRoomIds.size(); i++) {
+        int room = voxelRoomIds[i];
+        ZoneStatus& zone = zones[room];
+        // Огонь входит в помещение через проёмы и перекрытия
+        bool quiet = zone.burning == 0 && !hotAhead(room);
+        for (int door : roomGraph.doorsOf(room)) quiet = quiet && doorBurning[door] == 0;
+        for (const std::pair<int, double>& edge : roomGraph.neighbours(room)) {
+            if (roomGraph.room(edge.first).getFloor() == roomGraph.room(room).getFloor()) continue;
+            quiet = quiet && zones[edge.first].burning == 0;
+        }
+
+        zone.quietSteps = quiet ? zone.quietSteps + 1 : 0;
+        if (zone.quietSteps < ZONE_QUIET_STEPS) {
+            voxelRoomIds[kept++] = room;
+            continue;
+        }
+        zone.state = zone.burnt > 0 ? ZONE_BURNT_OUT : ZONE_IDLE;
+        zone.settledStep = step;
+        releaseRoom(room);
+    }
+    voxelRoomIds.resize(kept);
+}
+
+// Горячий слой за шаг: приход от горящих клеток (только в помещениях на
+// клетках - горят только они), перетекание по рёбрам графа, потери в стены.
+// Потоки по всем рёбрам считаются от теплоты на начало шага и копятся в
+// zoneFlow, поэтому за шаг теплота проходит одно ребро и не зависит от
+// порядка помещений. Поток по ребру - не больше половины того, что выровняло
+// бы помещения; если рёбер много, все потоки помещения уменьшаются так, чтобы
+// оно отдало не больше половины своей теплоты. Помещение, куда огонь ещё не
+// дошёл, а слой уже горячий, переходит на клетки: огонь туда придёт
+template <class Stencil>
+void FireEngine<Stencil>::exchangeZoneHeat() {
+    auto warm = [this](int room) {
+        if (zones[room].warm) return;
+        zones[room].warm = true;
+        warmRoomIds.push_back(room);
+    };
+    for (int room : voxelRoomIds) {
+        double heat = metrics.stepHeat(metrics.room(room));
+        if (heat <= 0) continue;
+        zones[room].heat += heat;
+        warm(room);
+    }
+
+    // Поток от более горячего помещения по ребру; у холодной стороны ребра - ноль
+    auto flow = [this](int from, const std::pair<int, double>& edge) {
+        const Room& source = roomGraph.room(from);
+        const Room& target = roomGraph.room(edge.first);
+        double a = source.getCellCount();
+        double b = target.getCellCount();
+        double difference = zones[from].heat / a - zones[edge.first].heat / b;
+        if (difference <= 0) return 0.0;
+        double exchange = source.getFloor() == target.getFloor() ? ZONE_DOOR_EXCHANGE : ZONE_SLAB_EXCHANGE;
+        return std::min(exchange * edge.second, 0.5 * a * b / (a + b)) * difference;
+    };
+    // Отдают только помещения со слоем на начало шага; получившие теплоту
+    // встают в конец списка и отдают её со следующего шага
+    std::size_t senders = warmRoomIds.size();
+    for (std::size_t i = 0; i < senders; i++) {
+        int from = warmRoomIds[i];
+        double outflow = 0;
+        for (const std::pair<int, double>& edge : roomGraph.neighbours(from)) outflow += flow(from, edge);
+        if (outflow <= 0) continue;
+        double scale = std::min(1.0, 0.5 * zones[from].heat / outflow);
+        for (const std::pair<int, double>& edge : roomGraph.neighbours(from)) {
+            double part = scale * flow(from, edge);
+            if (part <= 0) continue;
+            zoneFlow[from] -= part;
+            zoneFlow[edge.first] += part;
+            warm(edge.first);
+        }
+    }
+    for (int room : warmRoomIds) {
+        zones[room].heat += zoneFlow[room];
+        zoneFlow[room] = 0;
+    }
+
+    std::size_t kept = 0;
+    for (int room : warmRoomIds) {
+        ZoneStatus& zone = zones[room];
+        double area = roomGraph.room(room).getCellCount();
+        zone.heat *= 1 - ZONE_HEAT_LOSS;
+        if (zone.heat >= ZONE_HOT_LAYER * area && zone.hotLayerStep < 0) zone.hotLayerStep = step;
+        if (hotAhead(room)) activateRoom(room);
+        if (zone.heat < ZONE_COLD * area) {
+            zone.heat = 0;
+            zone.warm = false;
+            continue;
+        }
+        warmRoomIds[kept++] = room;
+    }
+    warmRoomIds.resize(kept);
+}
+
+// Слой горячий, а в помещении ещё ничего не горело и не горит
+template <class Stencil>
+bool FireEngine<Stencil>::hotAhead(int room) const {
+    const ZoneStatus& zone = zones[room];
+    return zone.burning == 0 && zone.burnt == 0 && zone.heat >= ZONE_HOT_LAYER * roomGraph.room(room).getCellCount();
+}
+
+// Освободить брики помещения, рядом с которыми нет огня и кандидатов.
+// Из клеток брика сохраняются только биты BURNT, остальное - по плану
+template <class Stencil>
+void FireEngine<Stencil>::releaseRoom(int room) {
+    if (!pixels.isSparse()) return;
+    const Room& bounds = roomGraph.room(room);
+    roomTiles.clear();
+    for (int x = bounds.getMinX(); x <= bounds.getMaxX(); x++) {
+        for (int y = bounds.getMinY(); y <= bounds.getMaxY(); y++) {
+            for (int z = roomGraph.floorBegin(bounds.getFloor()); z < roomGraph.floorEnd(bounds.getFloor()); z++) {
+                CellIndex tile = pixels.tileOf(pixels.index(x, y, z));
+                if (roomTiles.empty() || roomTiles.back() != tile) roomTiles.push_back(tile);
             }
         }
+    }
+    std::sort(roomTiles.begin(), roomTiles.end());
+    roomTiles.erase(std::unique(roomTiles.begin(), roomTiles.end()), roomTiles.end());
 
-        for (int i = 0; i < NewList->size; i++) {
-            Pixel* pixel = NewList->pixels[i];
-            int x = pixel->x;
-            int y = pixel->y;
-            int z = pixel->z;
-
-            // Проверка соседних пикселей во всех направлениях
-            for (int dx = -1; dx <= 1; dx++) {
-                for (int dy = -1; dy <= 1; dy++) {
-                    for (int dz = -1; dz <= 1; dz++) {
-                        // Пропускаем сам пиксель
-                        if (dx == 0 && dy == 0 && dz == 0) continue;
-
-                        int newX = x + dx;
-                        int newY = y + dy;
-                        int newZ = z + dz;
-
-                        // Проверяем, что координаты находятся в пределах комнаты
-                        if (newX >= 0 && newX < ROOM_HEIGHT &&
-                            newY >= 0 && newY < ROOM_WIDTH &&
-                            newZ >= 0 && newZ < ROOM_DEPTH) {
-
-                            // Проверяем состояние соседнего пикселя и стену на карте
-                            if (pixels[newX][newY][newZ].state < BURNING && MAP[newX * ROOM_WIDTH + newY] != '#') {
-                                addToList(CheckList, &pixels[newX][newY][newZ]);
-                            }
-                        }
-                    }
-                }
+    for (CellIndex tile : roomTiles) {
+        if (!pixels.isTileResident(tile) || activity.isActive(tile)) continue;
+        CellIndex first = tile * pixels.cellsPerTile();
+        CellIndex last = first + pixels.cellsPerTile();
+        bool pending = false;
+        for (CellIndex index = first; index < last && !pending; index++) {
+            pending = CheckList.contains(index) || NewList.contains(index);
+        }
+        if (pending) continue;
+        for (CellIndex index = first; index < last; index++) {
+            if (pixels[index].state == BURNT) burntCells[index >> 6] |= (std::uint64_t)1 << (index & 63);
+        }
+        pixels.releaseTile(tile);
+    }
+}
+
+// План здания без выделения сетки: размеры известны до initialize
+template <class Stencil>
+bool FireEngine<Stencil>::prepareBuilding() {
+    bool planar = Stencil::DIMENSIONS == 2;
+    bool planned = planPath.empty() ? floorPlan.fromLayer(plan, height, width, planar ? 1 : depth)
+                                    : floorPlan.load(planPath.c_str());
+    if (!planned) return false;
+    if (planar && floorPlan.depth() != 1) {
+        printf("Плоскому движку нужен план из одного слоя\n");
+        return false;
+    }
+    height = floorPlan.height();
+    width = floorPlan.width();
+    depth = floorPlan.depth();
+    if (floorPlan.hasStartFire()) setStartFire(floorPlan.startFireX(), floorPlan.startFireY(), floorPlan.startFireZ());
+    if (planar) startFireZ = 0;
+    return true;
+}
+
+template <class Stencil>
+bool FireEngine<Stencil>::initialize() {
+    finish();
+    if (!prepareBuilding()) return false;
+    if (checkpoint && !checkpointCompatible()) return false;
+
+    registry = MaterialRegistry::shared(materialsPath);
+    if (!registry) return false;
+
+    // Тип клетки по номеру материала легенды
+    const std::vector<PlanMaterial>& legend = floorPlan.materials();
+    materialTypes.assign(legend.size(), nullptr);
+    for (std::size_t i = 0; i < legend.size(); i++) {
+        if (legend[i].typeIndex < 0) continue;
+        if (!registry->contains(legend[i].typeIndex)) {
+            printf("Материал '%c': нет типа %d в %s\n", legend[i].symbol, legend[i].typeIndex, materialsPath.c_str());
+            finish();
+            return false;
+        }
+        materialTypes[i] = &(*registry)[(MaterialId)legend[i].typeIndex];
+    }
+
+    pool.reset(new ThreadPool(threadCount));
+    if (slabDomains) pool->pinThreads();
+
+    bool allocated;
+    if (sparseBricks || zoneModel || checkpoint) {
+        allocated = pixels.allocateSparse(height, width, depth, [this](CellIndex tile, Pixel* cells) {
+            initializeTile(tile, cells);
+        });
+    } else {
+        allocated = pixels.allocate(height, width, depth, tileStorePath.empty() ? nullptr : tileStorePath.c_str());
+    }
+    if (!allocated) {
+        printf("Не удалось выделить сетку %dx%dx%d\n", height, width, depth);
+        finish();
+        return false;
+    }
+    if (checkpoint && (checkpoint->header().tileCount != (std::uint64_t)pixels.tileCount() ||
+                       checkpoint->header().cellsPerTile != (std::uint32_t)pixels.cellsPerTile())) {
+        printf("Контрольная точка записана с другой раскладкой тайлов\n");
+        finish();
+        return false;
+    }
+    if (!pixels.inside(startFireY, startFireX, startFireZ)) {
+        printf("Очаг пожара вне здания\n");
+        finish();
+        return false;
+    }
+    if (!materialTypes[floorPlan.materialAt(startFireY, startFireX, startFireZ)]) {
+        printf("Очаг пожара в клетке без типа материала\n");
+        finish();
+        return false;
+    }
+    burntCells.clear();
+    if (zoneModel || metricsModel) roomGraph.build(floorPlan);
+    // Теплоту шага по помещениям для горячего слоя даёт FireMetrics
+    if (metricsModel || zoneModel) {
+        metrics.reset(registry->size(), roomGraph.roomCount(), (std::size_t)floorPlan.floors() * height * width,
+                      TIME_SPEED);
+    } else {
+        metrics.clear();
+    }
+    if (zoneModel) {
+        zones.assign(roomGraph.roomCount(), ZoneStatus{ZONE_IDLE, 0, 0, 0, -1, -1, 0.0, -1, false});
+        doorBurning.assign(roomGraph.doorCount(), 0);
+        voxelRoomIds.clear();
+        warmRoomIds.clear();
+        zoneFlow.assign(roomGraph.roomCount(), 0.0);
+        burntCells.assign((pixels.cellCount() + 63) / 64, 0);
+    }
+    if (slabDomains) {
+        domains.reset(pool->size(), height, width, depth, pixels.tileHeight());
+        pool->forEachWorker([this](int worker) {
+            if (worker < domains.count()) domains.allocate(worker);
+        });
+        slabCandidates.assign(domains.count(), std::vector<std::int32_t>());
+    }
+    if (!sparseBricks && !zoneModel && !checkpoint) initializePixels();
+    adjacency.attach(pixels, floorPlan);
+    if (smokeModel) {
+        smoke.reset(height, width, depth, TIME_SPEED, [this](int x, int y, int z) { return floorPlan.passable(x, y, z); });
+    } else {
+        smoke.clear();
+    }
+    activity.reset(pixels.tileCount());
+    burning.reset(slabDomains ? 0 : height, width, depth);
+    rowCandidates.assign((std::size_t)height * depth, 0);
+    rowSlot.assign((std::size_t)height * depth, -1);
+
+    CheckList.reset(pixels.cellCount(), pixels.cellsPerTile());
+    NewList.reset(pixels.cellCount(), pixels.cellsPerTile());
+    FireList.reset(pixels.cellCount(), pixels.cellsPerTile());
+    calendar.reset(CALENDAR_BUCKETS);
+    if (eventDriven) {
+        igniteAt.reset(pixels.cellCount(), pixels.cellsPerTile());
+        rescheduled.reset(pixels.cellCount(), pixels.cellsPerTile());
+        ignitions = IgnitionQueue();
+    }
+
+    step = 0;
+    burntCount = 0;
+    if (checkpoint) restoreCheckpoint();
+    else NewList.insert(pixels.index(startFireY, startFireX, startFireZ));
+    changedCells.clear();
+    updates.clear();
+    updatesFrom = step;
+    updatesTo = step;
+    if (keepStates) captureStates(stateBytes);
+    else stateBytes.clear();
+#if FIRE_PROFILING
+    profiler.open(profileCsvPath.c_str(), profileTracePath.c_str());
+#endif
+    return true;
+}
+
+// Контрольная точка подходит к зданию и режиму движка
+template <class Stencil>
+bool FireEngine<Stencil>::checkpointCompatible() const {
+    const CheckpointHeader& saved = checkpoint->header();
+    if ((int)saved.height != height || (int)saved.width != width || (int)saved.depth != depth) {
+        printf("Контрольная точка записана для сетки %ux%ux%u, у здания %dx%dx%d\n", saved.height, saved.width,
+               saved.depth, height, width, depth);
+        return false;
+    }
+    if ((int)saved.dimensions != Stencil::DIMENSIONS || (saved.eventDriven != 0) != eventDriven) {
+        printf("Контрольная точка записана другим движком (%uD, %s)\n", saved.dimensions,
+               saved.eventDriven ? "событийный" : "пошаговый");
+        return false;
+    }
+    if ((int)saved.calendarBuckets != CALENDAR_BUCKETS) {
+        printf("Контрольная точка записана с календарём на %u корзин\n", saved.calendarBuckets);
+        return false;
+    }
+    if (zoneModel || smokeModel || metricsModel) {
+        printf("Зональная модель, дым и итоги не входят в контрольную точку\n");
+        return false;
+    }
+    return true;
+}
+
+// Шаг, фронт и календарь из контрольной точки; сами клетки накладываются
+// на брики в initializeTile. Маска горящих клеток и активность бриков
+// строятся по горящим клеткам точки, брики при этом не создаются
+template <class Stencil>
+void FireEngine<Stencil>::restoreCheckpoint() {
+    const CheckpointHeader& saved = checkpoint->header();
+    step = saved.step;
+    burntCount = saved.burntCount;
+    if (!seedFixed) rng.setSeed(saved.seed);
+
+    for (CellIndex tile = 0; tile < pixels.tileCount(); tile++) {
+        for (const CheckpointCell& cell : checkpoint->tile(tile)) {
+            if (cell.state != BURNING) continue;
+            int x, y, z;
+            pixels.coords(tile * pixels.cellsPerTile() + cell.local, x, y, z);
+            setBurning(x, y, z);
+            activity.addBurning(pixels, tile);
+        }
+    }
+    // Вставка в сохранённом порядке восстанавливает порядок элементов
+    for (CellIndex cell : checkpoint->checkList()) CheckList.insert(cell);
+    for (CellIndex cell : checkpoint->newList()) NewList.insert(cell);
+    for (CellIndex cell : checkpoint->fireList()) FireList.insert(cell);
+    for (const CheckpointDue& entry : checkpoint->calendar()) calendar.schedule(entry.cell, entry.due);
+    if (eventDriven) {
+        CheckpointSpan<CellIndex> candidates = checkpoint->checkList();
+        for (std::size_t i = 0; i < candidates.size(); i++) {
+            int due = checkpoint->igniteSteps()[i];
+            igniteAt.set(candidates[i], due);
+            if (due >= 0) ignitions.push(IgnitionEvent{due, candidates[i]});
+        }
+    }
+}
+
+// Клетки не EMPTY по тайлам. Несозданный брик собирается во временный буфер
+// тем же initializeTile, так что запись не создаёт бриков
+template <class Stencil>
+bool FireEngine<Stencil>::saveCheckpoint(const char* path) {
+    if (pixels.tileCount() == 0) return false;
+    CheckpointState state;
+    CheckpointHeader& header = state.header;
+    header.height = height;
+    header.width = width;
+    header.depth = depth;
+    header.dimensions = Stencil::DIMENSIONS;
+    header.seed = rng.seed();
+    header.step = step;
+    header.eventDriven = eventDriven;
+    header.burntCount = burntCount;
+    header.tileCount = pixels.tileCount();
+    header.cellsPerTile = pixels.cellsPerTile();
+    header.calendarBuckets = calendar.buckets();
+
+    std::vector<Pixel> scratch(pixels.cellsPerTile());
+    state.tileStart.reserve(pixels.tileCount() + 1);
+    for (CellIndex tile = 0; tile < pixels.tileCount(); tile++) {
+        state.tileStart.push_back(state.cells.size());
+        CellIndex first = tile * pixels.cellsPerTile();
+        const Pixel* cells;
+        if (!pixels.isSparse() || pixels.isTileResident(tile)) {
+            cells = &pixels[first];
+        } else if (checkpoint || !burntCells.empty()) {
+            initializeTile(tile, scratch.data());
+            cells = scratch.data();
+        } else {
+            continue; // нетронутый брик
+        }
+        for (int local = 0; local < pixels.cellsPerTile(); local++) {
+            const Pixel& pixel = cells[local];
+            if (pixel.state == EMPTY) continue;
+            int burnTime = pixel.state == BURNING ? 0 : pixel.t;
+            state.cells.push_back(CheckpointCell{burnTime, pixel.burnStart, (std::uint16_t)local, (std::uint8_t)pixel.state, 0});
+        }
+    }
+    state.tileStart.push_back(state.cells.size());
+
+    state.checkList.assign(CheckList.begin(), CheckList.end());
+    if (eventDriven) {
+        for (CellIndex cell : CheckList) state.igniteSteps.push_back(igniteAt.get(cell));
+    }
+    state.newList.assign(NewList.begin(), NewList.end());
+    state.fireList.assign(FireList.begin(), FireList.end());
+    calendar.forEach([&state](CellIndex cell, int due) { state.calendar.push_back(CheckpointDue{cell, due, 0}); });
+    if (!state.write(path)) {
+        fprintf(stderr, "Не удалось записать файл %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::stepSimulation() {
+#if FIRE_PROFILING
+    if (profiler.isOpen()) profiler.beginStep(step);
+#endif
+    changedCells.clear();
+    if (eventDriven) {
+        stepEvents();
+    } else {
+        igniteCandidates();
+        expandNewFires();
+        burnOut();
+    }
+
+    if (smokeModel) {
+        FIRE_PROFILE_PHASE(profiler, PHASE_SMOKE);
+        smoke.advance(step, *pool);
+    }
+
+    releaseIdleTiles();
+    if (zoneModel) updateZones();
+    if (keepStates) {
+        FIRE_PROFILE_PHASE(profiler, PHASE_OUTPUT);
+        for (const CellChange& change : changedCells) {
+            int x, y, z;
+            pixels.coords(change.index, x, y, z);
+            stateBytes[((std::size_t)x * width + y) * depth + z] = (std::uint8_t)change.state;
+        }
+    }
+    step++;
+#if FIRE_PROFILING
+    if (profiler.isOpen()) {
+        int ignited, burntOut;
+        countChanges(ignited, burntOut);
+        profiler.endStep(CheckList.size(), FireList.size(), ignited, burntOut);
+    }
+#endif
+}
+
+template <class Stencil>
+bool FireEngine<Stencil>::isActive() const {
+    return CheckList.size() > 0 || NewList.size() > 0 || FireList.size() > 0;
+}
+
+// Изменения всех сделанных шагов копятся в updates: хост, пропустивший
+// кадры, получает их за один вызов
+template <class Stencil>
+int FireEngine<Stencil>::advance(int steps) {
+    updates.clear();
+    updatesFrom = step;
+    int done = 0;
+    for (; done < steps && isActive(); done++) {
+        stepSimulation();
+        collectUpdates(updates);
+    }
+    updatesTo = step;
+    return done;
+}
+
+template <class Stencil>
+FireStateView FireEngine<Stencil>::stateView() const {
+    return FireStateView{stateBytes.empty() ? nullptr : stateBytes.data(), height, width, depth, step};
+}
+
+template <class Stencil>
+FireChangeView FireEngine<Stencil>::changeView() const {
+    return FireChangeView{updates.data(), updates.size(), updatesFrom, updatesTo};
+}
+
+template <class Stencil>
+void FireEngine<Stencil>::finish() {
+#if FIRE_PROFILING
+    profiler.write();
+#endif
+    pool.reset();
+    pixels.release();
+    adjacency.clear();
+    materialTypes.clear();
+    registry.reset();
+}
+
+// Живой прогон. Вывод - на потоках конвейера (StepPipeline.h): живая карта
+// слоя z = 0, сводка прогона и, если задан, журнал изменений. Симулятор
+// только публикует запись шага и никогда не ждёт терминала
+template <class Stencil>
+void FireEngine<Stencil>::runSimulation() {
+    if (!initialize()) return;
+
+    std::vector<char> base((std::size_t)height * width);
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) base[(std::size_t)i * width + j] = floorPlan.symbolAt(i, j, 0);
+    }
+    if (checkpoint) {
+        for (CellIndex tile = 0; tile < pixels.tileCount(); tile++) {
+            for (const CheckpointCell& saved : checkpoint->tile(tile)) {
+                int x, y, z;
+                pixels.coords(tile * pixels.cellsPerTile() + saved.local, x, y, z);
+                if (z == 0) base[(std::size_t)x * width + y] = saved.state == BURNING ? '*' : 'X';
             }
+        }
+    }
+    RenderConsumer render;
+    StepStatistics statistics;
+    ChangeLogWriter changeLog;
+    StepPipeline pipeline;
+    pipeline.addConsumer(&render, OVERFLOW_BLOCK);
+    pipeline.addConsumer(&statistics, OVERFLOW_DROP);
+    if (!changeLogPath.empty()) {
+        if (changeLog.open(changeLogPath.c_str())) {
+            pipeline.addConsumer(&changeLog, OVERFLOW_BLOCK, CHANGE_LOG_CAPACITY);
+        } else {
+            fprintf(stderr, "Не удалось открыть файл %s\n", changeLogPath.c_str());
+        }
+    }
+    render.start(height, width, base.data(), stdout);
+    pipeline.start();
+
+    StepChanges record;
+    while (CheckList.size() > 0 || NewList.size() > 0 || FireList.size() > 0 && step < 100) {
+        stepSimulation();
 
-            // Перенос пикселя из NewList в FireList
-            pixel->state = BURNING;
-            addToList(FireList, pixel);
-            removeFromList(NewList, pixel);
+        {
+            FIRE_PROFILE_PHASE(profiler, PHASE_OUTPUT);
+            record.step = step;
+            record.candidates = CheckList.size();
+            record.burning = FireList.size();
+            if (record.burning > record.peakBurning) {
+                record.peakBurning = record.burning;
+                record.peakStep = step;
+            }
+            countChanges(record.ignited, record.burntOut);
+            record.burntTotal = burntCount;
+            record.changes.clear();
+            collectUpdates(record.changes);
+            pipeline.publish(record);
         }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000 / TIME_SPEED));
+    }
+
+    pipeline.stop();
+    printf("SEED: %llu, кадров: %lld, пропущено: %lld\n", (unsigned long long)rng.seed(),
+           (long long)render.getRenderer().framesDrawn(), (long long)render.getRenderer().framesDropped());
+    printf("Шагов: %d, больше всего горело %d клеток на шаге %d, выгорело %lld, шагов мимо сводки: %d\n",
+           statistics.lastStep(), statistics.peakBurning(), statistics.peakStep(), (long long)statistics.burntTotal(),
+           statistics.missedSteps());
+    finish();
+}
+
+// Строки CSV итогов за последний шаг: всё здание, затем материалы и
+// помещения, где что-то горит или догорело на этом шаге
+template <class Stencil>
+void FireEngine<Stencil>::writeMetrics(FILE* out) const {
+    auto row = [&](const char* group, int id, const char* name, const FireTotals& totals) {
+        fprintf(out, "%d,%s,%d,\"%s\",%d,%lld,%.1f,%.1f,%.3f\n", step, group, id, name, totals.burning,
+                (long long)totals.burnt, totals.burntArea * 1.0, totals.burnt * CELL_VOLUME,
+                metrics.heatRelease(totals));
+    };
+    auto changed = [&](const FireTotals& totals) {
+        return totals.burning > 0 || totals.retiredStep == step - 1;
+    };
+    row("total", -1, "", metrics.total());
+    for (int id = 0; id < metrics.materialCount(); id++) {
+        if (changed(metrics.material(id))) row("material", id, materialName(id), metrics.material(id));
+    }
+    for (int id = 0; id < metrics.roomCount(); id++) {
+        if (changed(metrics.room(id))) row("room", id, "", metrics.room(id));
+    }
+}
+
+// Без задержек и без карты на каждом шаге: только запрошенный вывод
+template <class Stencil>
+void FireEngine<Stencil>::runHeadless(const HeadlessOptions& options) {
+    if (!initialize()) return;
 
+    FILE* out = options.out ? options.out : stdout;
+    fprintf(out, "SEED: %llu\n", (unsigned long long)rng.seed());
+    if (options.stepCounts) fprintf(out, "step,candidates,burning,ignited,burnt_out,burnt_total\n");
 
-        // Обработка FireList
-        for (int i = 0; i < FireList->size; i++) {
-            Pixel* pixel = FireList->pixels[i];
+    FILE* tenability = nullptr;
+    if (options.tenabilityPath && smokeModel) {
+        tenability = fopen(options.tenabilityPath, "w");
+        if (!tenability) fprintf(stderr, "Не удалось открыть файл %s\n", options.tenabilityPath);
+        else fprintf(tenability, "step,untenable_cells,min_visibility_m,min_o2,max_co2,max_co,max_hcl\n");
+    }
+
+    FILE* metricsOut = nullptr;
+    if (options.metricsPath && metricsModel) {
+        metricsOut = fopen(options.metricsPath, "w");
+        if (!metricsOut) fprintf(stderr, "Не удалось открыть файл %s\n", options.metricsPath);
+        else fprintf(metricsOut, "step,group,id,name,burning,burnt,area_m2,volume_m3,hrr_kw\n");
+    }
+
+    FrameWriter recorder;
+    if (options.recordPath) {
+        if (!recorder.open(options.recordPath, height, width, depth, rng.seed(), options.keyframeEvery)) {
+            fprintf(stderr, "Не удалось открыть файл записи %s\n", options.recordPath);
+        } else {
+            captureStates(keyframeStates);
+            recorder.writeKeyframe(step, keyframeStates.data());
+        }
+    }
 
-            if (pixel->state == BURNING) {                
-                pixel->t += TIME_SPEED * 1; 
-                double A = 1.05 * pixel->pixel_type->BurningRate * pow(pixel->pixel_type->LinearFlameSpeed, 2);
-                double burntMass = A * pow(pixel->t, 3);
+    if (options.checkpointPath && step == options.checkpointStep) saveCheckpoint(options.checkpointPath);
+    while (isActive() && (options.maxSteps <= 0 || step < options.maxSteps)) {
+        stepSimulation();
 
-                if (pixel->fuel_mass <= burntMass) {
-                    pixel->state = BURNT;
-                    removeFromList(FireList, pixel);
-                    //delete pixel;
+        FIRE_PROFILE_PHASE(profiler, PHASE_OUTPUT);
+        if (options.stepCounts) {
+            int ignited;
+            int burntOut;
+            countChanges(ignited, burntOut);
+            fprintf(out, "%d,%d,%d,%d,%d,%lld\n", step, CheckList.size(), FireList.size(),
+                    ignited, burntOut, (long long)burntCount);
+        }
+        if (tenability) {
+            const SmokeStats& stats = smoke.stats();
+            fprintf(tenability, "%d,%d,%.3f,%.5f,%.6g,%.6g,%.6g\n", step, stats.untenableCells, stats.minVisibility,
+                    stats.minOxygen, stats.maxCO2, stats.maxCO, stats.maxHCl);
+        }
+        if (metricsOut) writeMetrics(metricsOut);
+        if (options.frameEvery > 0 && step % options.frameEvery == 0) {
+            fprintf(out, "Шаг %d:\n", step);
+            displayRoom(out);
+        }
+        if (recorder.isOpen()) {
+            if (recorder.wantsKeyframe(step)) {
+                captureStates(keyframeStates);
+                recorder.writeKeyframe(step, keyframeStates.data());
+            } else {
+                deltaEntries.clear();
+                for (const CellChange& change : changedCells) {
+                    deltaEntries.push_back(packDelta(cellKey(pixels[change.index]), change.state));
                 }
+                recorder.writeDelta(step, deltaEntries.data(), deltaEntries.size());
             }
         }
+        if (options.checkpointPath && step == options.checkpointStep) saveCheckpoint(options.checkpointPath);
+    }
+    if (options.checkpointPath && options.checkpointStep < 0) {
+        saveCheckpoint(options.checkpointPath);
+    } else if (options.checkpointPath && step < options.checkpointStep) {
+        fprintf(stderr, "Прогон закончился на шаге %d, контрольная точка шага %d не записана\n", step,
+                options.checkpointStep);
+    }
+    recorder.close();
+    if (tenability) fclose(tenability);
+    if (metricsOut) fclose(metricsOut);
 
-        step++;
-        //system("cls");
-        printf("Шаг %d:\n", step);
-        displayRoom(pixels, char_room);
-        Sleep(1000 / TIME_SPEED);
+    if (zoneModel) {
+        int detailed = 0;
+        int burntOut = 0;
+        int hot = 0;
+        for (const ZoneStatus& zone : zones) {
+            if (zone.activatedStep >= 0) detailed++;
+            if (zone.state == ZONE_BURNT_OUT) burntOut++;
+            if (zone.hotLayerStep >= 0) hot++;
+        }
+        fprintf(out, "Помещений: %d, по клеткам: %d, выгорело: %d, с горячим слоем: %d, бриков в памяти: %lld\n",
+                roomGraph.roomCount(), detailed, burntOut, hot, (long long)pixels.residentTiles());
     }
 
-    delete[] pixel_types;
-    delete[] CheckList->pixels;
-    delete[] NewList->pixels;
-    delete[] FireList->pixels;
-    delete CheckList;
-    delete NewList;
-    delete FireList;
-}
\ No newline at end of file
+    if (options.finalFrame && (options.frameEvery <= 0 || step % options.frameEvery != 0)) {
+        fprintf(out, "Шаг %d:\n", step);
+        displayRoom(out);
+    }
+    fflush(out);
+    finish();
+}
+
+template class FireEngine<Moore3D>;
+template class FireEngine<VonNeumann2D>;
@@ -1,8 +1,33 @@
 #ifndef FIRESIMULATION_H
 #define FIRESIMULATION_H
 
-#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include "BrickActivity.h"
+#include "BurnCalendar.h"
+#include "CellAdjacency.h"
+#include "Checkpoint.h"
+#include "CounterRng.h"
+#include "FireKernels.h"
+#include "FireMetrics.h"
+#include "FireView.h"
+#include "FloorPlan.h"
+#include "FrontierSet.h"
+#include "MaterialRegistry.h"
+#include "SlabDomains.h"
+#include "SmokeField.h"
+#include "Stencil.h"
+#include "StepProfiler.h"
+#include "ThreadPool.h"
+#include "VoxelGrid.h"
+#include "room_graph.hpp"
 
+// Размеры встроенной карты MAP (по умолчанию)
 #define ROOM_WIDTH 100
 #define ROOM_HEIGHT 34
 #define ROOM_DEPTH 50
@@ -20,19 +45,16 @@ extern const int START_FIRE_Z;
 
 extern const char * MAP;
 
-struct PixelType {
-    const char* Name;
-    double LowestHeatOfCombustion_kJ_per_kg;
-    double LinearFlameSpeed;
-    double BurningRate;
-    double SmokeGeneration;
-    double OxygenConsumption_kg_per_kg;
-    struct GasEmission {
-        double CarbonDioxide_kg_per_kg;
-        double CarbonMonoxide_kg_per_kg;
-        double HydrogenChloride_kg_per_kg;
-    } GasEmission;
-};
+// Таблица материалов без --materials: в текущем каталоге. Программы
+// передают вместо неё fire.json из своего каталога (besideBinary)
+const char* const DEFAULT_MATERIALS_PATH = "fire.json";
+
+// Файл name в каталоге исполняемого файла; без каталога в argv[0] - в текущем
+inline std::string besideBinary(const char* argv0, const char* name) {
+    std::string path = argv0;
+    std::size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? name : path.substr(0, slash + 1) + name;
+}
 
 struct Pixel {
     int state;
@@ -41,33 +63,323 @@ struct Pixel {
     int y;
     int z;
     double fuel_mass; 
-    int t; // Текущее время горения
+    int t; // Время горения; у горящей клетки - FireEngine::burningTime
+    int burnStart; // Шаг загорания
     const PixelType* pixel_type;
 };
 
-struct List {
-    Pixel** pixels;
-    int size;
+// Смена состояния клетки за шаг
+struct CellChange {
+    CellIndex index;
+    int state; // Новое состояние
+};
+
+// Помещение в зональной модели: без сетки (огня нет или уже нет)
+// или с подробным счётом по клеткам
+enum ZoneState { ZONE_IDLE, ZONE_VOXEL, ZONE_BURNT_OUT };
+
+// Пакетный режим: шаги без задержек, на выходе только запрошенное
+struct HeadlessOptions {
+    int maxSteps = 0;         // 0 - пока пожар не погаснет
+    bool stepCounts = false;  // CSV со счётчиками клеток на каждом шаге
+    int frameEvery = 0;       // карта каждые N шагов, 0 - не выводить
+    bool finalFrame = true;   // карта после последнего шага
+    FILE* out = nullptr;      // nullptr - stdout
+    const char* recordPath = nullptr; // двоичная запись кадров (FrameRecorder.h)
+    int keyframeEvery = 100;  // шагов между ключевыми кадрами записи
+    const char* tenabilityPath = nullptr; // CSV худших значений дыма и газов по шагам (setSmoke)
+    const char* metricsPath = nullptr;    // CSV итогов по материалам и помещениям по шагам (setMetrics)
+    const char* checkpointPath = nullptr; // контрольная точка (Checkpoint.h)
+    int checkpointStep = -1;              // после какого шага её записать, -1 - в конце прогона
 };
 
-class FireSimulation {
+// Движок клеточного автомата. Stencil (Stencil.h) задаёт при компиляции
+// размерность и окрестность распространения; у плоского движка depth = 1.
+template <class Stencil>
+class FireEngine {
 public:
-    FireSimulation();
-    ~FireSimulation();
+    FireEngine();
+    ~FireEngine();
+
+    // План этажа: height строк по width символов, выдавливается на depth слоёв
+    // (у плоского движка depth не используется)
+    void setBuilding(const char* plan, int height, int width, int depth);
+    // Таблица материалов (fire.json), nullptr - путь по умолчанию
+    void setMaterials(const char* path);
+    // Многоэтажный план из файла (FloorPlan.h), размеры берутся из плана
+    void setFloorPlan(const char* path);
+    void setStartFire(int x, int y, int z);
+    // Хранить клетки в файле и держать в памяти только тайлы у фронта пожара
+    void setTileStore(const char* path);
+    // Разреженные брики: брик создаётся при первом обращении к нему
+    void setSparseBricks(bool sparse);
+    // Событийный движок: шаг загорания кандидата разыгрывается заранее,
+    // тихие шаги почти ничего не стоят. Распределение то же, реализации другие
+    void setEventDriven(bool events);
+    // Зональная модель (RoomGraph): клетки считаются только в помещениях, куда
+    // подошёл огонь; выгоревшее помещение сворачивается до битов BURNT, его
+    // брики освобождаются. Включает разреженные брики, результат тот же
+    void setZoneModel(bool zones);
+    // Разбиение сетки на слои по x между потоками (SlabDomains.h). По слоям
+    // делятся только маска горящих клеток (между слоями ходят изменившиеся
+    // крайние строки) и проверка кандидатов по ней. Сетка клеток, списки
+    // фронта, фиксация решений, расширение фронта, активность бриков и
+    // смежность общие, и работают с ними как без слоёв. Тайлы плотной сетки
+    // первым касается поток слоя. Потоки закрепляются за процессорами, пока
+    // движок не вызовет finish
+    void setSlabDomains(bool slabs);
+    // Поля дыма и газов (SmokeField.h): источники - выгоревшая за шаг масса
+    void setSmoke(bool smoke);
+    // Итоги по зданию, материалам и помещениям (FireMetrics.h): горящие и
+    // выгоревшие клетки, площадь, мощность тепловыделения. Обновляются при
+    // смене состояния клеток; строит граф помещений, как зональная модель
+    void setMetrics(bool metrics);
+    // Замеры фаз шага (StepProfiler.h): CSV по шагам и trace-event JSON,
+    // пишутся в finish(). nullptr - файл не нужен
+    void setProfile(const char* csvPath, const char* tracePath);
+    // Журнал изменений клеток живого прогона (runSimulation), CSV
+    // step,x,y,z,state; пишется на своём потоке. nullptr - не писать
+    void setChangeLog(const char* path);
+    // Буфер состояний для stateView: байт на клетку (height * width * depth),
+    // после шага обновляются только сменившие состояние клетки
+    void setStateBuffer(bool enabled);
+    // Число потоков шага, 0 - по числу ядер
+    void setThreadCount(int threads);
+    // Продолжить счёт с контрольной точки (Checkpoint.h): initialize берёт из
+    // неё шаг, клетки и фронт вместо очага. Размеры сетки, размерность и
+    // режим движка должны совпадать; план и материалы могут отличаться
+    // (вариант вмешательства). Брики разреженные, брик копируется из общей
+    // точки при первом обращении, так что много прогонов от одной точки
+    // делят нетронутую часть сетки. Без setSeed продолжает с seed точки.
+    // Зональная модель, дым и итоги в точку не входят и вместе с ней не работают
+    void setCheckpoint(const std::shared_ptr<const Checkpoint>& checkpoint);
+    const std::shared_ptr<const Checkpoint>& getCheckpoint() const { return checkpoint; }
+    // Записать контрольную точку между шагами (после initialize)
+    bool saveCheckpoint(const char* path);
+    // Seed генератора; по умолчанию случайный, печатается в начале прогона
+    void setSeed(std::uint64_t seed);
+    std::uint64_t getSeed() const;
+
+    // Загрузить план здания (размеры, легенда) без выделения сетки
+    bool prepareBuilding();
+    // Пошаговый запуск без вывода: initialize, затем stepSimulation, пока isActive
+    bool initialize();
+    void stepSimulation();
+    bool isActive() const;
+    void finish();
+
+    // Встраивание во внешний движок: initialize, затем advance раз в кадр и
+    // чтение представлений (FireView.h) без копирования сетки.
+    // До steps шагов, пока пожар не погас; возвращает число сделанных шагов
+    int advance(int steps = 1);
+    // Состояния всех клеток (setStateBuffer), nullptr в states без буфера
+    FireStateView stateView() const;
+    // Клетки, сменившие состояние за последний advance
+    FireChangeView changeView() const;
+
+    int currentStep() const { return step; }
+    int getHeight() const { return height; }
+    int getWidth() const { return width; }
+    int getDepth() const { return depth; }
+    // Бриков с горящими клетками рядом / созданных в памяти
+    CellIndex activeBricks() const { return activity.activeCount(); }
+    CellIndex residentBricks() const { return pixels.residentTiles(); }
+    // Размер фронта: кандидаты CheckList и горящие клетки
+    int candidateCount() const { return CheckList.size(); }
+    int burningCount() const { return FireList.size(); }
+    std::int64_t burntTotal() const { return burntCount; }
+    // Клетки, сменившие состояние на последнем шаге
+    const std::vector<CellChange>& changedThisStep() const { return changedCells; }
+    const Pixel& pixelAt(CellIndex index) { return pixels[index]; }
+    CellIndex cellKey(const Pixel& pixel) const;
+    // Состояния всех клеток по ключу cellKey
+    void captureStates(std::vector<std::uint8_t>& states);
+    int burningTime(const Pixel& pixel) const;
+    const SmokeField& getSmoke() const { return smoke; }
+    const FireMetrics& getMetrics() const { return metrics; }
+    // Название материала с номером id в таблице материалов
+    const char* materialName(int id) const { return (*registry)[(MaterialId)id].Name; }
+    // Граф помещений и состояние помещений (в зональной модели)
+    const RoomGraph& getRoomGraph() const { return roomGraph; }
+    ZoneState zoneState(int room) const { return zones[room].state; }
+    // Теплота горячего слоя помещения, кДж на клетку плана, и шаг, когда
+    // слой впервые стал горячим (-1 - не становился)
+    double zoneHeat(int room) const { return zones[room].heat / roomGraph.room(room).getCellCount(); }
+    int hotLayerStep(int room) const { return zones[room].hotLayerStep; }
+    int voxelRooms() const { return (int)voxelRoomIds.size(); }
+    static double burntMass(const PixelType* type, int t);
+    static double burntMass(const Pixel& pixel);
 
     void runSimulation();
+    void runHeadless(const HeadlessOptions& options);
 
 private:
-    std::unordered_map<char, const PixelType*> pixelDataMap;
-    const char* JSON_FILE_PATH = "G:/VKR/Automates3/fire.json";
-
-    PixelType* loadData();
-    void initializePixels(const char room[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH], Pixel pixels[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH]);
-    void displayRoom(Pixel pixels[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH], char char_room[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH]);
-    int calculateFP(Pixel pixels[ROOM_HEIGHT][ROOM_WIDTH][ROOM_DEPTH], int x, int y, int z);
-    List* createList();
-    void addToList(List* list, Pixel* pixel);
-    void removeFromList(List* list, Pixel* pixel);
+    std::string materialsPath = DEFAULT_MATERIALS_PATH;
+    std::shared_ptr<const MaterialRegistry> registry;
+
+    const char* plan = MAP;
+    int height = ROOM_HEIGHT;
+    int width = ROOM_WIDTH;
+    int depth = ROOM_DEPTH;
+    int startFireX = START_FIRE_X;
+    int startFireY = START_FIRE_Y;
+    int startFireZ = START_FIRE_Z;
+    std::string tileStorePath;
+    std::string planPath;
+
+    FloorPlan floorPlan;
+    std::vector<const PixelType*> materialTypes; // по номеру материала плана
+    bool sparseBricks = false;
+    VoxelGrid<Pixel> pixels;
+    BrickActivity activity;
+    CellAdjacency<Stencil, VoxelGrid<Pixel>> adjacency; // соседи клеток и веса рёбер по плану
+    BurningMask burning;
+    bool slabDomains = false;
+    SlabDomains domains;
+    std::vector<std::vector<std::int32_t>> slabCandidates; // позиции в CheckList по слоям
+    std::vector<char> activeTiles;
+
+    // Фронт пожара, индексы клеток в pixels
+    FrontierSet CheckList;
+    FrontierSet NewList;
+    FrontierSet FireList;
+    BurnCalendar calendar; // Шаги догорания клеток FireList
+
+    // Решения по клеткам CheckList за текущий шаг
+    enum CheckDecision : std::uint8_t { CHECK_KEEP, CHECK_DROP, CHECK_IGNITE };
+    static constexpr int STEP_GRAIN = 1024;
+    int threadCount = 0;
+    std::unique_ptr<ThreadPool> pool;
+    CounterRng rng;
+    bool seedFixed = false; // seed задан setSeed, а не случайный
+    std::shared_ptr<const Checkpoint> checkpoint;
+    int step = 0;
+    std::vector<CellChange> changedCells;
+    bool smokeModel = false;
+    SmokeField smoke;
+    bool metricsModel = false;
+    FireMetrics metrics;
+    std::string profileCsvPath;
+    std::string changeLogPath;
+    static constexpr int CHANGE_LOG_CAPACITY = 256; // шагов в очереди журнала
+    std::string profileTracePath;
+    StepProfiler profiler;
+    std::int64_t burntCount = 0;
+    bool keepStates = false;
+    std::vector<std::uint8_t> stateBytes;  // по ключу cellKey
+    std::vector<CellUpdate> updates;       // изменения последнего advance
+    int updatesFrom = 0;
+    int updatesTo = 0;
+    std::string frame;
+    std::vector<std::uint8_t> keyframeStates;
+    std::vector<std::uint64_t> deltaEntries;
+    std::vector<std::uint8_t> checkDecisions;
+    std::vector<int> burnOutDue;
+    static constexpr int CALENDAR_BUCKETS = 1024;
+
+    // Событийный движок: шаг загорания каждого кандидата, -1 - не назначен;
+    // в очереди могут лежать устаревшие записи, они пропускаются
+    struct IgnitionEvent {
+        int step;
+        CellIndex cell;
+        bool operator>(const IgnitionEvent& other) const {
+            return step != other.step ? step > other.step : cell > other.cell;
+        }
+    };
+    typedef std::priority_queue<IgnitionEvent, std::vector<IgnitionEvent>, std::greater<IgnitionEvent>> IgnitionQueue;
+    bool eventDriven = false;
+    BrickSlots igniteAt;
+    IgnitionQueue ignitions;
+    FrontierSet rescheduled;
+    std::vector<std::vector<CellIndex>> expansion;
+
+    // Зональная модель. Помещение переходит на клетки, когда огонь подходит
+    // к нему (кандидат или горящая клетка в нём или в его проёме) или когда
+    // в нём, ещё не горевшем, собирается горячий слой, и сворачивается, когда
+    // ZONE_QUIET_STEPS шагов подряд не горят ни оно, ни его проёмы, ни
+    // помещения над и под ним и слой не держит его на клетках.
+    //
+    // Горячий слой - теплота дымовых газов помещения (heat, кДж). Приходит
+    // от горящих клеток помещения (теплота шага из FireMetrics), уходит в
+    // стены (ZONE_HEAT_LOSS за шаг) и перетекает в соседние помещения по
+    // рёбрам RoomGraph: через проём - пропорционально его ширине
+    // (ZONE_DOOR_EXCHANGE), через перекрытие - площади над/под
+    // (ZONE_SLAB_EXCHANGE), из более нагретого (кДж на клетку плана) в менее
+    // нагретое. Слой горячий от ZONE_HOT_LAYER кДж на клетку плана: это
+    // слой 1 м при +500 K (1.2 кг/м³ * 1 кДж/(кг*K) * 500 K)
+    struct ZoneStatus {
+        ZoneState state;
+        int burning;
+        int burnt;
+        int quietSteps;
+        int activatedStep;
+        int settledStep;
+        double heat;
+        int hotLayerStep;
+        bool warm;         // в списке warmRoomIds
+    };
+    static constexpr int ZONE_QUIET_STEPS = 2;
+    static constexpr double ZONE_HOT_LAYER = 600;       // кДж на клетку плана
+    static constexpr double ZONE_COLD = 1;              // ниже - слоя нет, кДж на клетку плана
+    static constexpr double ZONE_HEAT_LOSS = 0.05;      // доля теплоты слоя за шаг
+    static constexpr double ZONE_DOOR_EXCHANGE = 0.5;   // клеток плана на клетку проёма за шаг
+    static constexpr double ZONE_SLAB_EXCHANGE = 0.02;  // клеток плана на клетку перекрытия за шаг
+    bool zoneModel = false;
+    RoomGraph roomGraph;
+    std::vector<ZoneStatus> zones;
+    std::vector<int> doorBurning;
+    std::vector<int> voxelRoomIds;
+    std::vector<int> warmRoomIds; // помещения с горячим слоем выше ZONE_COLD
+    std::vector<double> zoneFlow; // приход теплоты за шаг по рёбрам, нули между шагами
+    std::vector<std::uint64_t> burntCells; // BURNT-клетки освобождённых бриков, по индексу
+    std::vector<CellIndex> roomTiles;
+
+    // Строчное ядро fp: строка считается целиком, если кандидатов в ней
+    // не меньше width / ROW_KERNEL_RATIO
+    static constexpr int ROW_KERNEL_RATIO = 16;
+    std::vector<std::int32_t> rowCandidates; // height * depth, нули между шагами
+    std::vector<std::int32_t> rowSlot;       // номер строки в rowFp или -1
+    std::vector<std::int32_t> touchedRows;
+    std::vector<std::uint8_t> rowFp;
+
+    void initializeTile(CellIndex tile, Pixel* cells);
+    void initializePixels();
+    bool checkpointCompatible() const;
+    void restoreCheckpoint();
+    void displayRoom(FILE* out);
+    void countChanges(int& ignited, int& burntOut) const;
+    void collectUpdates(std::vector<CellUpdate>& out) const;
+    int calculateFP(int x, int y, int z);
+    double weightedFP(CellIndex index, int x, int y, int z) const;
+    const BurningMask& maskAt(int x) const;
+    void setBurning(int x, int y, int z);
+    void clearBurning(int x, int y, int z);
+    void exchangeHalos();
+    static int burnOutSteps(const Pixel& pixel);
+    void releaseIdleTiles();
+    void countRowCandidates();
+    void igniteCandidates();
+    void igniteCell(CellIndex index);
+    void stepEvents();
+    void scheduleIgnition(CellIndex index);
+    void expandNewFires();
+    void burnOut();
+    void addSmokeSource(const Pixel& pixel);
+    static double stepEnergy(const Pixel& pixel, int burnStep);
+    static double burnCoefficient(const PixelType* type);
+    void countMetrics(const Pixel& pixel, bool ignited);
+    void writeMetrics(FILE* out) const;
+    bool releasedBurnt(CellIndex index) const;
+    void activateRoom(int room);
+    void approachZone(int x, int y, int z);
+    void countZoneBurning(const Pixel& pixel, int delta);
+    void updateZones();
+    void exchangeZoneHeat();
+    bool hotAhead(int room) const;
+    void releaseRoom(int room);
 };
 
+typedef FireEngine<Moore3D> FireSimulation;
+typedef FireEngine<VonNeumann2D> FireSimulation2D;
+
 #endif // FIRESIMULATION_H
@@ -0,0 +1,46 @@
+#ifndef FIREVIEW_H
+#define FIREVIEW_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Представления состояния движка для внешнего кода (игровой движок,
+// визуализация): указатели смотрят прямо в буферы FireEngine, ничего не
+// копируется. Читать их можно между вызовами advance: буфер состояний
+// обновляется на месте и живёт до следующего initialize, список изменений
+// переписывается каждым advance.
+
+// Клетка, сменившая состояние за шаг, с координатами сетки
+struct CellUpdate {
+    std::int32_t x;
+    std::int32_t y;
+    std::int32_t z;
+    std::int32_t state;
+};
+
+// Состояния всех клеток, байт на клетку (EMPTY, BURNING, BURNT),
+// клетка (x, y, z) - states[(x * width + y) * depth + z]
+struct FireStateView {
+    const std::uint8_t* states; // nullptr, если буфер состояний не включён
+    int height;
+    int width;
+    int depth;
+    int step;
+
+    std::uint8_t at(int x, int y, int z) const { return states[((std::size_t)x * width + y) * depth + z]; }
+};
+
+// Изменения за шаги firstStep + 1 .. lastStep (последний вызов advance) в
+// порядке шагов: применённые по порядку к прошлому кадру дают текущий
+struct FireChangeView {
+    const CellUpdate* cells;
+    std::size_t count;
+    int firstStep;
+    int lastStep;
+
+    const CellUpdate* begin() const { return cells; }
+    const CellUpdate* end() const { return cells + count; }
+    std::size_t size() const { return count; }
+};
+
+#endif // FIREVIEW_H
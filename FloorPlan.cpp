@@ -0,0 +1,448 @@
+#include "FloorPlan.h"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const std::uint32_t PLAN_CACHE_MAGIC = 0x4C505346; // "FSPL"
+const std::uint32_t PLAN_CACHE_VERSION = 4;
+
+struct PlanCacheHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    std::uint32_t height;
+    std::uint32_t width;
+    std::uint32_t depth;
+    std::uint32_t floors;
+    std::uint32_t materials;
+    std::uint32_t fireSet;
+    std::int32_t fireX;
+    std::int32_t fireY;
+    std::int32_t fireZ;
+    std::uint32_t reserved;
+};
+
+struct PlanCacheMaterial {
+    double fuelMass;
+    std::int32_t typeIndex;
+    std::uint8_t symbol;
+    std::uint8_t passable;
+    std::uint8_t door;
+    std::uint8_t reserved;
+    float spread;
+    float spreadUp;
+    float spreadDown;
+    std::uint32_t reserved2;
+};
+
+static std::uint64_t padded(std::uint64_t bytes) {
+    return (bytes + 7) & ~(std::uint64_t)7;
+}
+
+FloorPlan::FloorPlan() {
+    clear();
+}
+
+void FloorPlan::clear() {
+    h = 0;
+    w = 0;
+    floorCount = 0;
+    legend.clear();
+    zFloor.clear();
+    ownCodes.clear();
+    codes = nullptr;
+    cacheFile.close();
+    cached = false;
+    fireSet = false;
+    fireX = fireY = fireZ = 0;
+}
+
+// FNV-1a
+static void mix(std::uint64_t& hash, const void* data, std::size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (std::size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+}
+
+std::uint64_t FloorPlan::fingerprint() const {
+    std::uint64_t hash = 14695981039346656037ull;
+    int size[3] = {h, w, floorCount};
+    mix(hash, size, sizeof(size));
+    mix(hash, zFloor.data(), zFloor.size() * sizeof(int));
+    for (const PlanMaterial& material : legend) {
+        mix(hash, &material.symbol, sizeof(material.symbol));
+        mix(hash, &material.typeIndex, sizeof(material.typeIndex));
+        mix(hash, &material.passable, sizeof(material.passable));
+        mix(hash, &material.spread, sizeof(material.spread));
+        mix(hash, &material.spreadUp, sizeof(material.spreadUp));
+        mix(hash, &material.spreadDown, sizeof(material.spreadDown));
+    }
+    if (codes) mix(hash, codes, (std::size_t)floorCount * h * w);
+    return hash;
+}
+
+bool FloorPlan::sameAs(const FloorPlan& other) const {
+    if (h != other.h || w != other.w || floorCount != other.floorCount || zFloor != other.zFloor ||
+        legend.size() != other.legend.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < legend.size(); i++) {
+        const PlanMaterial& a = legend[i];
+        const PlanMaterial& b = other.legend[i];
+        if (a.symbol != b.symbol || a.typeIndex != b.typeIndex || a.passable != b.passable ||
+            a.spread != b.spread || a.spreadUp != b.spreadUp || a.spreadDown != b.spreadDown) {
+            return false;
+        }
+    }
+    return floorCount == 0 || memcmp(codes, other.codes, (std::size_t)floorCount * h * w) == 0;
+}
+
+void FloorPlan::copyFrom(const FloorPlan& other) {
+    clear();
+    h = other.h;
+    w = other.w;
+    floorCount = other.floorCount;
+    legend = other.legend;
+    zFloor = other.zFloor;
+    if (floorCount > 0) ownCodes.assign(other.codes, other.codes + (std::size_t)floorCount * h * w);
+    codes = ownCodes.data();
+    fireSet = other.fireSet;
+    fireX = other.fireX;
+    fireY = other.fireY;
+    fireZ = other.fireZ;
+}
+
+// Материалы встроенной карты MAP
+void FloorPlan::defaultLegend() {
+    legend.clear();
+    legend.push_back(PlanMaterial{' ', 15, 50, true, false});
+    legend.push_back(PlanMaterial{'t', 6, 5, true, false});
+    legend.push_back(PlanMaterial{'d', 3, 10, true, true});
+    legend.push_back(PlanMaterial{'m', 19, 20, true, false});
+    legend.push_back(PlanMaterial{'f', 15, 5, true, false});
+    legend.push_back(PlanMaterial{'#', 7, 200, false, false});
+}
+
+// Номер материала по символу, -1 - символа нет в легенде
+static int codeOf(const short table[256], char symbol) {
+    return table[(unsigned char)symbol];
+}
+
+// Проходимая клетка может загореться, поэтому ей нужен тип из fire.json
+static bool typedIfPassable(const PlanMaterial& material) {
+    return !material.passable || material.typeIndex >= 0;
+}
+
+// Символ после слова директивы: первый непробельный или символ в кавычках.
+// rest сдвигается за символ; 0 - символа нет
+static char parseSymbol(const char*& rest) {
+    while (*rest == ' ' || *rest == '\t') rest++;
+    char symbol = *rest;
+    if (symbol == '\'' && rest[1] && rest[2] == '\'') {
+        symbol = rest[1];
+        rest += 3;
+    } else if (symbol) {
+        rest++;
+    }
+    return symbol;
+}
+
+static void buildTable(const std::vector<PlanMaterial>& legend, short table[256]) {
+    for (int c = 0; c < 256; c++) table[c] = -1;
+    for (std::size_t i = 0; i < legend.size(); i++) table[(unsigned char)legend[i].symbol] = (short)i;
+}
+
+bool FloorPlan::fromLayer(const char* layer, int height, int width, int depth) {
+    clear();
+    if (height <= 0 || width <= 0 || depth <= 0) return false;
+    defaultLegend();
+    h = height;
+    w = width;
+    floorCount = 1;
+    zFloor.assign(depth, 0);
+
+    short table[256];
+    buildTable(legend, table);
+    ownCodes.resize((std::size_t)h * w);
+    for (std::size_t i = 0; i < ownCodes.size(); i++) {
+        int code = codeOf(table, layer[i]);
+        if (code < 0) {
+            printf("Неизвестный символ '%c' в карте (строка %d)\n", layer[i], (int)(i / w));
+            return false;
+        }
+        ownCodes[i] = (std::uint8_t)code;
+    }
+    codes = ownCodes.data();
+    return true;
+}
+
+bool FloorPlan::load(const char* path, const char* cachePath) {
+    clear();
+    std::string cache = cachePath ? cachePath : std::string(path) + ".cache";
+    std::uint64_t size = 0;
+    std::int64_t time = 0;
+    if (!MappedFile::stamp(path, size, time)) {
+        printf("Нет файла плана %s\n", path);
+        return false;
+    }
+    if (readCache(cache.c_str(), size, time)) return true;
+
+    clear();
+    if (!parse(path)) {
+        clear();
+        return false;
+    }
+    if (!writeCache(cache.c_str(), size, time)) printf("Не удалось записать кэш плана %s\n", cache.c_str());
+    return true;
+}
+
+bool FloorPlan::parse(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return false;
+    std::string text;
+    char buffer[1 << 16];
+    std::size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, read);
+    fclose(file);
+
+    defaultLegend();
+    short table[256];
+    buildTable(legend, table);
+
+    int layerRows = 0;  // сколько строк текущего этажа ещё читать
+    int lineNumber = 0;
+    std::size_t position = 0;
+    while (position < text.size()) {
+        std::size_t end = text.find('\n', position);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(position, end - position);
+        position = end + 1;
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+
+        if (layerRows > 0) {
+            if ((int)line.size() > w) {
+                printf("%s:%d: строка длиннее %d символов\n", path, lineNumber, w);
+                return false;
+            }
+            line.resize(w, ' ');
+            int x = h - layerRows;
+            std::uint8_t* row = &ownCodes[((std::size_t)(floorCount - 1) * h + x) * w];
+            for (int y = 0; y < w; y++) {
+                int code = codeOf(table, line[y]);
+                if (code < 0) {
+                    printf("%s:%d: символ '%c' не описан в material\n", path, lineNumber, line[y]);
+                    return false;
+                }
+                row[y] = (std::uint8_t)code;
+            }
+            layerRows--;
+            continue;
+        }
+
+        char word[32] = {0};
+        if (sscanf(line.c_str(), "%31s", word) != 1 || word[0] == '#') continue;
+        if (!strcmp(word, "size")) {
+            if (sscanf(line.c_str(), "%*s %d %d", &h, &w) != 2 || h <= 0 || w <= 0 || floorCount > 0) {
+                printf("%s:%d: ожидается size <высота> <ширина> до первого этажа\n", path, lineNumber);
+                return false;
+            }
+        } else if (!strcmp(word, "material")) {
+            const char* rest = line.c_str() + line.find("material") + 8;
+            char symbol = parseSymbol(rest);
+            PlanMaterial material = {symbol, -1, 0, true, false};
+            char flag[16] = {0};
+            int fields = sscanf(rest, "%d %lf %15s", &material.typeIndex, &material.fuelMass, flag);
+            if (!symbol || fields < 2) {
+                printf("%s:%d: ожидается material <символ> <тип> <масса> [wall | door]\n", path, lineNumber);
+                return false;
+            }
+            material.passable = strcmp(flag, "wall") != 0;
+            material.door = strcmp(flag, "door") == 0;
+            if (!typedIfPassable(material)) {
+                printf("%s:%d: у проходимого материала '%c' нет типа (-1 только для wall)\n", path, lineNumber, symbol);
+                return false;
+            }
+            short code = table[(unsigned char)symbol];
+            if (code >= 0) {
+                legend[code] = material;
+            } else {
+                if (legend.size() >= 256) return false;
+                legend.push_back(material);
+                table[(unsigned char)symbol] = (short)(legend.size() - 1);
+            }
+        } else if (!strcmp(word, "spread")) {
+            const char* rest = line.c_str() + line.find("spread") + 6;
+            char symbol = parseSymbol(rest);
+            float spread = 1, up = 1, down = 1;
+            int fields = sscanf(rest, "%f %f %f", &spread, &up, &down);
+            short code = table[(unsigned char)symbol];
+            if (!symbol || (fields != 1 && fields != 3) || spread < 0 || up < 0 || down < 0) {
+                printf("%s:%d: ожидается spread <символ> <множитель> [<вверх> <вниз>]\n", path, lineNumber);
+                return false;
+            }
+            if (code < 0) {
+                printf("%s:%d: spread для материала '%c' без material\n", path, lineNumber, symbol);
+                return false;
+            }
+            // Без вертикальных множителей вверх и вниз огонь идёт как по горизонтали
+            legend[code].spread = spread;
+            legend[code].spreadUp = fields == 3 ? up : spread;
+            legend[code].spreadDown = fields == 3 ? down : spread;
+        } else if (!strcmp(word, "fire")) {
+            if (sscanf(line.c_str(), "%*s %d %d %d", &fireX, &fireY, &fireZ) != 3) {
+                printf("%s:%d: ожидается fire <x> <y> <z>\n", path, lineNumber);
+                return false;
+            }
+            fireSet = true;
+        } else if (!strcmp(word, "floor")) {
+            int slices = 0;
+            if (h <= 0 || sscanf(line.c_str(), "%*s %d", &slices) != 1 || slices <= 0) {
+                printf("%s:%d: ожидается floor <число слоёв> после size\n", path, lineNumber);
+                return false;
+            }
+            floorCount++;
+            ownCodes.resize((std::size_t)floorCount * h * w, 0);
+            zFloor.insert(zFloor.end(), slices, floorCount - 1);
+            layerRows = h;
+        } else {
+            printf("%s:%d: неизвестная строка '%s'\n", path, lineNumber, word);
+            return false;
+        }
+    }
+    if (layerRows > 0 || floorCount == 0) {
+        printf("%s: план неполный\n", path);
+        return false;
+    }
+    codes = ownCodes.data();
+    return true;
+}
+
+bool FloorPlan::readCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime) {
+    if (!cacheFile.open(path, false)) return false;
+    const std::uint8_t* base = (const std::uint8_t*)cacheFile.data();
+    std::uint64_t size = cacheFile.size();
+    if (!base || size < sizeof(PlanCacheHeader)) {
+        cacheFile.close();
+        return false;
+    }
+    const PlanCacheHeader* header = (const PlanCacheHeader*)base;
+    if (header->magic != PLAN_CACHE_MAGIC || header->version != PLAN_CACHE_VERSION ||
+        header->sourceSize != sourceSize || header->sourceTime != sourceTime ||
+        header->materials == 0 || header->materials > 256 || header->floors == 0 ||
+        header->height == 0 || header->height > INT_MAX || header->width == 0 || header->width > INT_MAX ||
+        header->depth == 0 || header->depth > INT_MAX) {
+        cacheFile.close();
+        return false;
+    }
+
+    // Слой height * width в uint64 не переполняется; число этажей ограничивается
+    // размером файла до умножения
+    std::uint64_t offset = sizeof(PlanCacheHeader);
+    std::uint64_t floorOffset = offset + header->materials * sizeof(PlanCacheMaterial);
+    std::uint64_t codeOffset = floorOffset + padded(header->depth * sizeof(std::int32_t));
+    std::uint64_t layerBytes = (std::uint64_t)header->height * header->width;
+    if (header->floors > size / layerBytes || codeOffset + header->floors * layerBytes > size) {
+        cacheFile.close();
+        return false;
+    }
+    std::uint64_t codeBytes = header->floors * layerBytes;
+
+    // Карта читается движком без проверок: слои, номера материалов и очаг
+    // должны быть внутри плана, иначе текст разбирается заново
+    const std::int32_t* floorsOfZ = (const std::int32_t*)(base + floorOffset);
+    for (std::uint32_t z = 0; z < header->depth; z++) {
+        if (floorsOfZ[z] < 0 || (std::uint32_t)floorsOfZ[z] >= header->floors) {
+            cacheFile.close();
+            return false;
+        }
+    }
+    const std::uint8_t* cacheCodes = base + codeOffset;
+    for (std::uint64_t i = 0; i < codeBytes; i++) {
+        if (cacheCodes[i] >= header->materials) {
+            cacheFile.close();
+            return false;
+        }
+    }
+    if (header->fireSet && (header->fireY < 0 || (std::uint32_t)header->fireY >= header->height ||
+                            header->fireX < 0 || (std::uint32_t)header->fireX >= header->width ||
+                            header->fireZ < 0 || (std::uint32_t)header->fireZ >= header->depth)) {
+        cacheFile.close();
+        return false;
+    }
+
+    const PlanCacheMaterial* materials = (const PlanCacheMaterial*)(base + offset);
+    for (std::uint32_t i = 0; i < header->materials; i++) {
+        PlanMaterial material = {(char)materials[i].symbol, materials[i].typeIndex,
+                                 materials[i].fuelMass, materials[i].passable != 0,
+                                 materials[i].door != 0};
+        if (!typedIfPassable(material)) {
+            cacheFile.close();
+            return false;
+        }
+        material.spread = materials[i].spread;
+        material.spreadUp = materials[i].spreadUp;
+        material.spreadDown = materials[i].spreadDown;
+        legend.push_back(material);
+    }
+    zFloor.assign(floorsOfZ, floorsOfZ + header->depth);
+    h = (int)header->height;
+    w = (int)header->width;
+    floorCount = (int)header->floors;
+    fireSet = header->fireSet != 0;
+    fireX = header->fireX;
+    fireY = header->fireY;
+    fireZ = header->fireZ;
+    codes = cacheCodes;
+    cached = true;
+    return true;
+}
+
+bool FloorPlan::writeCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime) const {
+    std::string temporary = MappedFile::temporaryPath(path);
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+
+    PlanCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PLAN_CACHE_MAGIC;
+    header.version = PLAN_CACHE_VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.height = h;
+    header.width = w;
+    header.depth = (std::uint32_t)zFloor.size();
+    header.floors = floorCount;
+    header.materials = (std::uint32_t)legend.size();
+    header.fireSet = fireSet;
+    header.fireX = fireX;
+    header.fireY = fireY;
+    header.fireZ = fireZ;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (const PlanMaterial& material : legend) {
+        PlanCacheMaterial record;
+        memset(&record, 0, sizeof(record));
+        record.fuelMass = material.fuelMass;
+        record.typeIndex = material.typeIndex;
+        record.symbol = (std::uint8_t)material.symbol;
+        record.passable = material.passable;
+        record.door = material.door;
+        record.spread = material.spread;
+        record.spreadUp = material.spreadUp;
+        record.spreadDown = material.spreadDown;
+        ok = ok && fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+
+    std::vector<std::int32_t> floorsOfZ(zFloor.begin(), zFloor.end());
+    floorsOfZ.resize(padded(floorsOfZ.size() * sizeof(std::int32_t)) / sizeof(std::int32_t), 0);
+    if (!floorsOfZ.empty()) ok = ok && fwrite(floorsOfZ.data(), sizeof(std::int32_t), floorsOfZ.size(), file) == floorsOfZ.size();
+    ok = ok && fwrite(codes, 1, ownCodes.size(), file) == ownCodes.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return MappedFile::replace(temporary.c_str(), path);
+}
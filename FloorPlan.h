@@ -0,0 +1,105 @@
+#ifndef FLOORPLAN_H
+#define FLOORPLAN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Материал из легенды плана
+struct PlanMaterial {
+    char symbol;
+    int typeIndex;   // индекс типа в fire.json, -1 - без типа (только у стен)
+    double fuelMass; // запас топлива клетки, кг
+    bool passable;   // false - огонь через клетку не переходит (стены)
+    bool door;       // дверь: граница помещений (RoomGraph)
+    // Множители проводимости (CellAdjacency): по горизонтали, вверх и вниз.
+    // Вес ребра между клетками - произведение множителей обеих
+    float spread = 1;
+    float spreadUp = 1;
+    float spreadDown = 1;
+};
+
+// План здания: этажи - слои символов height x width, каждый этаж занимает
+// несколько слоёв по z. Символ клетки переводится в номер материала легенды.
+//
+// Текстовый формат:
+//   # комментарий
+//   size <height> <width>
+//   material <символ> <индекс в fire.json> <масса топлива> [wall | door]
+//   spread <символ> <множитель> [<вверх> <вниз>] - проводимость материала,
+//                                          после его material (по умолчанию 1)
+//   fire <x> <y> <z>                       - очаг, как в setStartFire (необязательно)
+//   floor <число слоёв>
+//   <height строк по width символов>
+//   floor ...
+// Символ в material и spread можно взять в кавычки: ' '. Легенда по умолчанию
+// (t, d, m, f, #, пробел) действует, пока её не переопределили; символ карты
+// не из легенды и проходимый материал без типа - ошибка загрузки.
+//
+// Подготовленная сетка (номера материалов, легенда, слои этажей) пишется
+// в двоичный кэш; при следующей загрузке кэш отображается в память без
+// разбора текста, пока у исходного файла не изменились размер и время записи
+// (в наносекундах). Кэш заменяется целиком (MappedFile::replace), поэтому
+// его можно делить между процессами.
+class FloorPlan {
+public:
+    FloorPlan();
+
+    // Один этаж из строки height * width, выдавленный на depth слоёв
+    bool fromLayer(const char* layer, int height, int width, int depth);
+    // cachePath = nullptr - кэш рядом с планом (<план>.cache)
+    bool load(const char* path, const char* cachePath = nullptr);
+    void clear();
+
+    int height() const { return h; }
+    int width() const { return w; }
+    int depth() const { return (int)zFloor.size(); }
+    int floors() const { return floorCount; }
+    int floorOf(int z) const { return zFloor[z]; }
+    bool fromCache() const { return cached; }
+
+    bool hasStartFire() const { return fireSet; }
+    int startFireX() const { return fireX; }
+    int startFireY() const { return fireY; }
+    int startFireZ() const { return fireZ; }
+
+    const std::vector<PlanMaterial>& materials() const { return legend; }
+    int materialAt(int x, int y, int z) const {
+        return codes[((std::size_t)zFloor[z] * h + x) * w + y];
+    }
+    const PlanMaterial& material(int x, int y, int z) const { return legend[materialAt(x, y, z)]; }
+    char symbolAt(int x, int y, int z) const { return material(x, y, z).symbol; }
+    bool passable(int x, int y, int z) const { return legend[materialAt(x, y, z)].passable; }
+    bool door(int x, int y, int z) const { return legend[materialAt(x, y, z)].door; }
+
+    // Хэш размеров, слоёв, легенды и карты: одинаковые планы из разных
+    // файлов и прогонов дают одно значение (общая CellAdjacency)
+    std::uint64_t fingerprint() const;
+    // Совпадает всё, что входит в fingerprint: проверка после совпадения хэша
+    bool sameAs(const FloorPlan& other) const;
+    // Копия плана в своей памяти, без отображённого кэша
+    void copyFrom(const FloorPlan& other);
+
+private:
+    void defaultLegend();
+    bool parse(const char* path);
+    bool readCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime);
+    bool writeCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime) const;
+
+    int h;
+    int w;
+    int floorCount;
+    std::vector<PlanMaterial> legend;
+    std::vector<int> zFloor;
+    std::vector<std::uint8_t> ownCodes;
+    const std::uint8_t* codes; // ownCodes или отображённый кэш
+    MappedFile cacheFile;
+    bool cached;
+    bool fireSet;
+    int fireX;
+    int fireY;
+    int fireZ;
+};
+
+#endif // FLOORPLAN_H
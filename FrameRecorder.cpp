@@ -0,0 +1,190 @@
+#include "FrameRecorder.h"
+#include <algorithm>
+#include <cstring>
+
+static std::uint64_t padded(std::uint64_t bytes) {
+    return (bytes + 7) & ~(std::uint64_t)7;
+}
+
+FrameWriter::FrameWriter() : file(nullptr), offset(0) {
+    memset(&header, 0, sizeof(header));
+}
+
+FrameWriter::~FrameWriter() {
+    close();
+}
+
+bool FrameWriter::open(const char* path, int height, int width, int depth, std::uint64_t seed, int keyframeInterval) {
+    close();
+    file = fopen(path, "wb");
+    if (!file) return false;
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+
+    header.magic = FRAME_FILE_MAGIC;
+    header.version = FRAME_FILE_VERSION;
+    header.height = height;
+    header.width = width;
+    header.depth = depth;
+    header.keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 0;
+    header.seed = seed;
+    header.cellCount = (std::uint64_t)height * width * depth;
+    fwrite(&header, sizeof(header), 1, file);
+    offset = sizeof(header);
+    index.clear();
+    return true;
+}
+
+// Оглавление и хвост дописываются при закрытии
+void FrameWriter::close() {
+    if (!file) return;
+    FrameFileTrailer trailer;
+    trailer.indexOffset = offset;
+    trailer.frameCount = index.size();
+    trailer.magic = FRAME_TRAILER_MAGIC;
+    trailer.reserved = 0;
+    if (!index.empty()) fwrite(index.data(), sizeof(FrameIndexEntry), index.size(), file);
+    fwrite(&trailer, sizeof(trailer), 1, file);
+    fclose(file);
+    file = nullptr;
+}
+
+bool FrameWriter::wantsKeyframe(int step) const {
+    if (index.empty()) return true;
+    return header.keyframeInterval > 0 && step % header.keyframeInterval == 0;
+}
+
+void FrameWriter::writeKeyframe(int step, const std::uint8_t* states) {
+    writeFrame(FRAME_KEY, step, states, header.cellCount, header.cellCount);
+}
+
+void FrameWriter::writeDelta(int step, const std::uint64_t* entries, std::uint64_t count) {
+    writeFrame(FRAME_DELTA, step, entries, count, count * sizeof(std::uint64_t));
+}
+
+void FrameWriter::writeFrame(std::uint32_t type, int step, const void* data, std::uint64_t count, std::uint64_t bytes) {
+    if (!file) return;
+    index.push_back(FrameIndexEntry{offset, type, (std::uint32_t)step});
+
+    FrameHeader frame;
+    frame.type = type;
+    frame.step = (std::uint32_t)step;
+    frame.count = count;
+    fwrite(&frame, sizeof(frame), 1, file);
+    if (bytes > 0) fwrite(data, 1, (std::size_t)bytes, file);
+
+    static const char zeros[8] = {0};
+    std::uint64_t pad = padded(bytes) - bytes;
+    if (pad > 0) fwrite(zeros, 1, (std::size_t)pad, file);
+    offset += sizeof(frame) + padded(bytes);
+}
+
+// Кадр по смещению offset целиком внутри файла: ключевой кадр ровно на cellCount клеток,
+// длина дельты ограничена остатком файла до умножения
+static bool frameFits(const std::uint8_t* base, std::uint64_t size, std::uint64_t offset, std::uint64_t cellCount) {
+    if (offset % 8 != 0 || offset < sizeof(FrameFileHeader) || size < sizeof(FrameHeader) || offset > size - sizeof(FrameHeader)) {
+        return false;
+    }
+    const FrameHeader* frame = (const FrameHeader*)(base + offset);
+    std::uint64_t space = size - offset - sizeof(FrameHeader);
+    if (frame->type == FRAME_KEY) return frame->count == cellCount && cellCount <= space;
+    if (frame->type == FRAME_DELTA) return frame->count <= space / sizeof(std::uint64_t);
+    return false;
+}
+
+bool FrameReader::open(const char* path) {
+    close();
+    if (!file.open(path, false)) return false;
+    base = (const std::uint8_t*)file.data();
+    std::uint64_t size = file.size();
+    if (!base || size < sizeof(FrameFileHeader)) {
+        close();
+        return false;
+    }
+    fileHeader = (const FrameFileHeader*)base;
+    const FrameFileHeader& h = *fileHeader;
+    if (h.magic != FRAME_FILE_MAGIC || h.version != FRAME_FILE_VERSION ||
+        h.cellCount != (std::uint64_t)h.height * h.width * h.depth) {
+        close();
+        return false;
+    }
+
+    // Оглавление из хвоста файла; если запись оборвалась - проходим по кадрам.
+    // Каждая запись оглавления проверяется по самому кадру: дальше кадры читаются без проверок
+    if (size >= sizeof(FrameFileHeader) + sizeof(FrameFileTrailer)) {
+        const FrameFileTrailer* trailer = (const FrameFileTrailer*)(base + size - sizeof(FrameFileTrailer));
+        std::uint64_t indexSpace = size - sizeof(FrameFileTrailer);
+        if (trailer->magic == FRAME_TRAILER_MAGIC && trailer->indexOffset <= indexSpace &&
+            trailer->frameCount == (indexSpace - trailer->indexOffset) / sizeof(FrameIndexEntry) &&
+            trailer->indexOffset + trailer->frameCount * sizeof(FrameIndexEntry) == indexSpace) {
+            const FrameIndexEntry* entries = (const FrameIndexEntry*)(base + trailer->indexOffset);
+            bool valid = trailer->indexOffset % 8 == 0;
+            for (std::uint64_t i = 0; valid && i < trailer->frameCount; i++) {
+                const FrameIndexEntry& entry = entries[i];
+                valid = frameFits(base, trailer->indexOffset, entry.offset, h.cellCount);
+                if (!valid) break;
+                const FrameHeader* frame = (const FrameHeader*)(base + entry.offset);
+                valid = frame->type == entry.type && frame->step == entry.step && (i == 0 || entries[i - 1].step <= entry.step);
+            }
+            if (valid) {
+                frames.assign(entries, entries + trailer->frameCount);
+                return true;
+            }
+        }
+    }
+
+    std::uint64_t offset = sizeof(FrameFileHeader);
+    while (frameFits(base, size, offset, h.cellCount)) {
+        const FrameHeader* frame = (const FrameHeader*)(base + offset);
+        if (!frames.empty() && frames.back().step > frame->step) break;
+        std::uint64_t bytes = frame->type == FRAME_KEY ? frame->count : frame->count * sizeof(std::uint64_t);
+        frames.push_back(FrameIndexEntry{offset, frame->type, frame->step});
+        offset += sizeof(FrameHeader) + padded(bytes);
+    }
+    return true;
+}
+
+void FrameReader::close() {
+    file.close();
+    base = nullptr;
+    fileHeader = nullptr;
+    frames.clear();
+}
+
+FrameView FrameReader::frame(std::size_t i) const {
+    const FrameHeader* frame = (const FrameHeader*)(base + frames[i].offset);
+    const std::uint8_t* data = (const std::uint8_t*)(frame + 1);
+    FrameView view;
+    view.type = (FrameType)frame->type;
+    view.step = (int)frame->step;
+    view.count = frame->count;
+    view.states = view.type == FRAME_KEY ? data : nullptr;
+    view.changes = view.type == FRAME_DELTA ? (const std::uint64_t*)data : nullptr;
+    return view;
+}
+
+std::size_t FrameReader::findFrame(int step) const {
+    std::vector<FrameIndexEntry>::const_iterator it = std::upper_bound(frames.begin(), frames.end(), step,
+        [](int s, const FrameIndexEntry& entry) { return s < (int)entry.step; });
+    return it == frames.begin() ? 0 : (std::size_t)(it - frames.begin()) - 1;
+}
+
+bool FrameReader::reconstruct(int step, std::vector<std::uint8_t>& states) const {
+    if (frames.empty()) return false;
+    std::size_t last = findFrame(step);
+    std::size_t key = last;
+    while (key > 0 && frames[key].type != FRAME_KEY) key--;
+    if (frames[key].type != FRAME_KEY) return false;
+
+    FrameView keyframe = frame(key);
+    states.assign(keyframe.states, keyframe.states + keyframe.count);
+    // Ключи дельт open не просматривает: клетка вне сетки значит испорченную запись
+    for (std::size_t i = key + 1; i <= last; i++) {
+        FrameView delta = frame(i);
+        for (std::uint64_t c = 0; c < delta.count; c++) {
+            std::uint64_t cell = deltaKey(delta.changes[c]);
+            if (cell >= states.size()) return false;
+            states[(std::size_t)cell] = (std::uint8_t)deltaState(delta.changes[c]);
+        }
+    }
+    return true;
+}
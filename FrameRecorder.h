@@ -0,0 +1,112 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "MappedFile.h"
+
+// Двоичная запись прогона.
+//
+// Файл: FrameFileHeader, затем кадры (FrameHeader + данные), затем оглавление
+// (FrameIndexEntry на каждый кадр) и FrameFileTrailer. Все поля выровнены
+// на 8 байт, поэтому кадры читаются прямо из отображённого файла.
+//
+// Ключевой кадр - состояние всех клеток, по байту на клетку.
+// Дельта - только клетки, сменившие состояние: uint64 (ключ клетки << 2 | состояние).
+// Ключ клетки - (x * width + y) * depth + z.
+
+const std::uint32_t FRAME_FILE_MAGIC = 0x43525346;   // "FSRC"
+const std::uint32_t FRAME_FILE_VERSION = 1;
+const std::uint32_t FRAME_TRAILER_MAGIC = 0x58444E49; // "INDX"
+
+enum FrameType : std::uint32_t { FRAME_KEY = 0, FRAME_DELTA = 1 };
+
+struct FrameFileHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t height;
+    std::uint32_t width;
+    std::uint32_t depth;
+    std::uint32_t keyframeInterval;
+    std::uint64_t seed;
+    std::uint64_t cellCount;
+};
+
+struct FrameHeader {
+    std::uint32_t type;
+    std::uint32_t step;
+    std::uint64_t count; // байт состояний для ключевого кадра, записей для дельты
+};
+
+struct FrameIndexEntry {
+    std::uint64_t offset;
+    std::uint32_t type;
+    std::uint32_t step;
+};
+
+struct FrameFileTrailer {
+    std::uint64_t indexOffset;
+    std::uint64_t frameCount;
+    std::uint32_t magic;
+    std::uint32_t reserved;
+};
+
+inline std::uint64_t packDelta(std::uint64_t key, int state) { return (key << 2) | (std::uint64_t)(state & 3); }
+inline std::uint64_t deltaKey(std::uint64_t entry) { return entry >> 2; }
+inline int deltaState(std::uint64_t entry) { return (int)(entry & 3); }
+
+class FrameWriter {
+public:
+    FrameWriter();
+    ~FrameWriter();
+
+    bool open(const char* path, int height, int width, int depth, std::uint64_t seed, int keyframeInterval);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    // Ключевой кадр нужен на этом шаге (первый кадр и каждые keyframeInterval шагов)
+    bool wantsKeyframe(int step) const;
+    void writeKeyframe(int step, const std::uint8_t* states);
+    void writeDelta(int step, const std::uint64_t* entries, std::uint64_t count);
+
+private:
+    void writeFrame(std::uint32_t type, int step, const void* data, std::uint64_t count, std::uint64_t bytes);
+
+    FILE* file;
+    FrameFileHeader header;
+    std::uint64_t offset;
+    std::vector<FrameIndexEntry> index;
+};
+
+// Кадр без копирования: указатели смотрят в отображённый файл
+struct FrameView {
+    FrameType type;
+    int step;
+    const std::uint8_t* states;   // ключевой кадр, header.cellCount байт
+    const std::uint64_t* changes; // дельта, count записей
+    std::uint64_t count;
+};
+
+class FrameReader {
+public:
+    bool open(const char* path);
+    void close();
+
+    const FrameFileHeader& header() const { return *fileHeader; }
+    std::size_t frameCount() const { return frames.size(); }
+    FrameView frame(std::size_t i) const;
+
+    // Номер кадра с последним шагом <= step
+    std::size_t findFrame(int step) const;
+    // Состояние всех клеток после шага step: от ближайшего ключевого кадра вперёд по дельтам
+    bool reconstruct(int step, std::vector<std::uint8_t>& states) const;
+
+private:
+    MappedFile file;
+    const std::uint8_t* base = nullptr;
+    const FrameFileHeader* fileHeader = nullptr;
+    std::vector<FrameIndexEntry> frames;
+};
+
+#endif // FRAMERECORDER_H
@@ -0,0 +1,142 @@
+#ifndef FRONTIERSET_H
+#define FRONTIERSET_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+typedef std::int64_t CellIndex;
+
+// Значение int32 на клетку, по умолчанию -1. Память - блоками по брику
+// (тайлу VoxelGrid, клетки брика идут подряд): блок заводится при первой
+// записи в брик и уходит в запас, когда в нём не остаётся значений. Занято
+// столько блоков, сколько бриков задето сейчас, а не вся сетка.
+class BrickSlots {
+public:
+    // brickCells - степень двойки
+    void reset(CellIndex cellCount, int brickCells) {
+        shift = 0;
+        while ((1 << shift) < brickCells) shift++;
+        mask = ((CellIndex)1 << shift) - 1;
+        blocks.assign((std::size_t)((cellCount + mask) >> shift), nullptr);
+        used.assign(blocks.size(), 0);
+        if (((std::size_t)1 << shift) != blockCells) {
+            storage.clear();
+            blockCells = (std::size_t)1 << shift;
+        }
+        spare.clear();
+        for (std::unique_ptr<std::int32_t[]>& block : storage) {
+            fill(block.get());
+            spare.push_back(block.get());
+        }
+    }
+
+    std::int32_t get(CellIndex cell) const {
+        const std::int32_t* block = blocks[cell >> shift];
+        return block ? block[cell & mask] : -1;
+    }
+
+    void set(CellIndex cell, std::int32_t value) {
+        std::int32_t*& block = blocks[cell >> shift];
+        if (!block) {
+            if (value < 0) return;
+            block = take();
+        }
+        std::int32_t& slot = block[cell & mask];
+        std::int32_t& count = used[cell >> shift];
+        if (slot < 0 && value >= 0) count++;
+        if (slot >= 0 && value < 0) count--;
+        slot = value;
+        if (count == 0) {
+            spare.push_back(block);
+            block = nullptr;
+        }
+    }
+
+    // Занятых блоков и байт под них
+    std::size_t blocksInUse() const { return storage.size() - spare.size(); }
+    std::size_t bytes() const { return storage.size() * blockCells * sizeof(std::int32_t); }
+
+private:
+    std::int32_t* take() {
+        if (spare.empty()) {
+            storage.emplace_back(new std::int32_t[blockCells]);
+            fill(storage.back().get());
+            return storage.back().get();
+        }
+        std::int32_t* block = spare.back();
+        spare.pop_back();
+        return block;
+    }
+    void fill(std::int32_t* block) const {
+        for (std::size_t i = 0; i < blockCells; i++) block[i] = -1;
+    }
+
+    int shift = 0;
+    CellIndex mask = 0;
+    std::size_t blockCells = 0;
+    std::vector<std::int32_t*> blocks; // nullptr - в брике все -1
+    std::vector<std::int32_t> used;    // значений >= 0 в блоке брика
+    std::vector<std::unique_ptr<std::int32_t[]>> storage;
+    std::vector<std::int32_t*> spare;  // пустые блоки (все -1)
+};
+
+// Множество клеток фронта (CheckList / NewList / FireList).
+// Плотный массив элементов + позиция каждой клетки в нём (BrickSlots):
+// вставка, удаление и проверка принадлежности за O(1), без дубликатов.
+// Ёмкость сохраняется между шагами, realloc на каждый элемент больше нет.
+class FrontierSet {
+public:
+    FrontierSet() {}
+
+    // Подготовить множество под сетку из cellCount клеток с бриками по brickCells
+    void reset(CellIndex cellCount, int brickCells) {
+        items.clear();
+        slots.reset(cellCount, brickCells);
+    }
+
+    int size() const { return (int)items.size(); }
+    bool empty() const { return items.empty(); }
+
+    CellIndex operator[](int i) const { return items[i]; }
+    const CellIndex* begin() const { return items.data(); }
+    const CellIndex* end() const { return items.data() + items.size(); }
+
+    bool contains(CellIndex cell) const {
+        return slots.get(cell) >= 0;
+    }
+
+    // Возвращает false, если клетка уже была во множестве
+    bool insert(CellIndex cell) {
+        if (slots.get(cell) >= 0) return false;
+        slots.set(cell, (std::int32_t)items.size());
+        items.push_back(cell);
+        return true;
+    }
+
+    // Удаление переставляет последний элемент на место удалённого,
+    // поэтому при удалении во время обхода идём с конца.
+    bool erase(CellIndex cell) {
+        std::int32_t slot = slots.get(cell);
+        if (slot < 0) return false;
+        CellIndex last = items.back();
+        items[slot] = last;
+        slots.set(last, slot);
+        items.pop_back();
+        slots.set(cell, -1);
+        return true;
+    }
+
+    void clear() {
+        for (CellIndex cell : items) slots.set(cell, -1);
+        items.clear();
+    }
+
+    std::size_t slotBytes() const { return slots.bytes(); }
+
+private:
+    std::vector<CellIndex> items;
+    BrickSlots slots;
+};
+
+#endif // FRONTIERSET_H
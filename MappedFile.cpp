@@ -0,0 +1,203 @@
+#include "MappedFile.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+#ifdef _WIN32
+    : file(INVALID_HANDLE_VALUE), mapping(nullptr),
+#else
+    : fd(-1),
+#endif
+      writable(false), fileSize(0), whole(nullptr) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+std::size_t MappedFile::granularity() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return (std::size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+std::string MappedFile::temporaryPath(const char* path) {
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    return std::string(path) + ".tmp." + std::to_string(pid);
+}
+
+bool MappedFile::replace(const char* temporary, const char* path) {
+#ifdef _WIN32
+    bool ok = MoveFileExA(temporary, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool ok = rename(temporary, path) == 0;
+#endif
+    if (!ok) remove(temporary);
+    return ok;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::stamp(const char* path, std::uint64_t& size, std::int64_t& time) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) return false;
+    size = ((std::uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    time = (std::int64_t)(((std::uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+    return true;
+}
+
+bool MappedFile::create(const char* path, std::uint64_t size) {
+    close();
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER li;
+    li.QuadPart = (LONGLONG)size;
+    if (!SetFilePointerEx(file, li, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    writable = true;
+    fileSize = size;
+    return true;
+}
+
+bool MappedFile::open(const char* path, bool write) {
+    close();
+    file = CreateFileA(path, write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER li;
+    if (!GetFileSizeEx(file, &li) || li.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, write ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    writable = write;
+    fileSize = (std::uint64_t)li.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (whole) UnmapViewOfFile(whole);
+    whole = nullptr;
+    if (mapping) CloseHandle(mapping);
+    mapping = nullptr;
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+    fileSize = 0;
+    writable = false;
+}
+
+bool MappedFile::isOpen() const {
+    return mapping != nullptr;
+}
+
+void* MappedFile::map(std::uint64_t offset, std::size_t length) {
+    if (!mapping) return nullptr;
+    return MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+                         (DWORD)(offset >> 32), (DWORD)offset, length);
+}
+
+void MappedFile::unmap(void* address, std::size_t length) {
+    if (!address) return;
+    if (writable) FlushViewOfFile(address, length);
+    UnmapViewOfFile(address);
+}
+
+#else
+
+bool MappedFile::stamp(const char* path, std::uint64_t& size, std::int64_t& time) {
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+    size = (std::uint64_t)info.st_size;
+#ifdef __APPLE__
+    time = (std::int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+    time = (std::int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool MappedFile::create(const char* path, std::uint64_t size) {
+    close();
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close();
+        return false;
+    }
+    writable = true;
+    fileSize = size;
+    return true;
+}
+
+bool MappedFile::open(const char* path, bool write) {
+    close();
+    fd = ::open(path, write ? O_RDWR : O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close();
+        return false;
+    }
+    writable = write;
+    fileSize = (std::uint64_t)st.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (whole) munmap(whole, fileSize);
+    whole = nullptr;
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+    fileSize = 0;
+    writable = false;
+}
+
+bool MappedFile::isOpen() const {
+    return fd >= 0;
+}
+
+void* MappedFile::map(std::uint64_t offset, std::size_t length) {
+    if (fd < 0) return nullptr;
+    void* address = mmap(nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, (off_t)offset);
+    return address == MAP_FAILED ? nullptr : address;
+}
+
+void MappedFile::unmap(void* address, std::size_t length) {
+    if (!address) return;
+    munmap(address, length);
+}
+
+#endif
+
+const void* MappedFile::data() {
+    if (!whole && isOpen()) whole = map(0, (std::size_t)fileSize);
+    return whole;
+}
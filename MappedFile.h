@@ -0,0 +1,63 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Файл, отображённый в память (Windows и POSIX).
+// Можно отображать файл целиком или отдельные участки (map/unmap),
+// смещения участков должны быть кратны granularity().
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Создать (или перезаписать) файл заданного размера для чтения и записи
+    bool create(const char* path, std::uint64_t size);
+    // Открыть существующий файл; writable = false - только чтение
+    bool open(const char* path, bool writable);
+    void close();
+
+    bool isOpen() const;
+    bool isWritable() const { return writable; }
+    std::uint64_t size() const { return fileSize; }
+
+    // Отобразить участок файла. Возвращает nullptr при ошибке.
+    void* map(std::uint64_t offset, std::size_t length);
+    // Сбросить изменения на диск и убрать участок из памяти
+    void unmap(void* address, std::size_t length);
+
+    // Отобразить весь файл одним участком (для чтения кэшей и записей)
+    const void* data();
+
+    // Размер и время записи файла без открытия: признак устаревшего кэша.
+    // Время - в наносекундах на POSIX, в сотнях наносекунд на Windows
+    static bool stamp(const char* path, std::uint64_t& size, std::int64_t& time);
+
+    // Кэши и контрольные точки пишутся во временный файл <path>.tmp.<pid> и
+    // переименовываются поверх path: процесс, отобразивший path, видит либо
+    // старый файл, либо новый целиком, но не обрезанный и не дописываемый
+    static std::string temporaryPath(const char* path);
+    // false - не вышло, временный файл удалён
+    static bool replace(const char* temporary, const char* path);
+
+    // Шаг смещений для map(): страница на POSIX, гранулярность выделения на Windows
+    static std::size_t granularity();
+
+private:
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#else
+    int fd;
+#endif
+    bool writable;
+    std::uint64_t fileSize;
+    void* whole;
+};
+
+#endif // MAPPEDFILE_H
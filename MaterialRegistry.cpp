@@ -0,0 +1,203 @@
+#include "MaterialRegistry.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include "rapidjson/document.h"
+#include "rapidjson/filereadstream.h"
+
+const std::uint32_t MATERIAL_CACHE_MAGIC = 0x544D5346; // "FSMT"
+const std::uint32_t MATERIAL_CACHE_VERSION = 2;
+
+struct MaterialCacheHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    std::uint32_t count;
+    std::uint32_t nameBytes;
+};
+
+struct MaterialCacheRecord {
+    double lowestHeatOfCombustion;
+    double linearFlameSpeed;
+    double burningRate;
+    double smokeGeneration;
+    double oxygenConsumption;
+    double carbonDioxide;
+    double carbonMonoxide;
+    double hydrogenChloride;
+    std::uint32_t nameOffset;
+    std::uint32_t reserved;
+};
+
+std::shared_ptr<const MaterialRegistry> MaterialRegistry::shared(const std::string& path) {
+    static std::mutex lock;
+    static std::unordered_map<std::string, std::shared_ptr<const MaterialRegistry>> registries;
+
+    std::lock_guard<std::mutex> guard(lock);
+    std::shared_ptr<const MaterialRegistry>& registry = registries[path];
+    if (!registry) {
+        std::shared_ptr<MaterialRegistry> loaded(new MaterialRegistry());
+        if (!loaded->load(path.c_str())) {
+            registries.erase(path);
+            return nullptr;
+        }
+        registry = loaded;
+    }
+    return registry;
+}
+
+bool MaterialRegistry::load(const char* path, const char* cachePath) {
+    std::string cache = cachePath ? cachePath : std::string(path) + ".cache";
+    std::uint64_t size = 0;
+    std::int64_t time = 0;
+    if (!MappedFile::stamp(path, size, time)) {
+        printf("Ошибка при считывании файла %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    if (readCache(cache.c_str(), size, time)) return true;
+
+    if (!parse(path)) return false;
+    if (!writeCache(cache.c_str(), size, time)) printf("Не удалось записать кэш материалов %s\n", cache.c_str());
+    return true;
+}
+
+bool MaterialRegistry::parse(const char* path) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        printf("Ошибка при считывании файла %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    std::vector<char> readBuffer(1 << 16);
+    rapidjson::FileReadStream is(fp, readBuffer.data(), readBuffer.size());
+
+    rapidjson::Document d;
+    d.ParseStream(is);
+
+    fclose(fp);
+
+    if (d.HasParseError() || !d.IsArray() || d.Size() >= NO_MATERIAL) {
+        printf("Файл %s: ожидается массив материалов\n", path);
+        return false;
+    }
+
+    // Названия копируются в свой блок: строки документа живут только до конца разбора
+    int numElements = d.Size();
+    types.resize(numElements);
+    names.clear();
+    nameOffsets.resize(numElements);
+    for (int i = 0; i < numElements; i++) {
+        const rapidjson::Value& obj = d[i];
+        const char* name = obj["Name"].GetString();
+        nameOffsets[i] = (std::uint32_t)names.size();
+        names.insert(names.end(), name, name + strlen(name) + 1);
+
+        types[i].LowestHeatOfCombustion_kJ_per_kg = obj["LowestHeatOfCombustion_kJ_per_kg"].GetDouble();
+        types[i].LinearFlameSpeed = obj["LinearFlameSpeed"].GetDouble();
+        types[i].BurningRate = obj["BurningRate"].GetDouble();
+        types[i].SmokeGeneration = obj["SmokeGeneration"].GetDouble();
+        types[i].OxygenConsumption_kg_per_kg = obj["OxygenConsumption_kg_per_kg"].GetDouble();
+
+        const rapidjson::Value& gasEmission = obj["GasEmission"];
+        types[i].GasEmission.CarbonDioxide_kg_per_kg = gasEmission["CarbonDioxide_kg_per_kg"].GetDouble();
+        types[i].GasEmission.CarbonMonoxide_kg_per_kg = gasEmission["CarbonMonoxide_kg_per_kg"].GetDouble();
+        types[i].GasEmission.HydrogenChloride_kg_per_kg = gasEmission["HydrogenChloride_kg_per_kg"].GetDouble();
+    }
+    for (int i = 0; i < numElements; i++) types[i].Name = &names[nameOffsets[i]];
+    indexNames();
+    return true;
+}
+
+bool MaterialRegistry::readCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime) {
+    if (!cacheFile.open(path, false)) return false;
+    const std::uint8_t* base = (const std::uint8_t*)cacheFile.data();
+    std::uint64_t size = cacheFile.size();
+    const MaterialCacheHeader* header = (const MaterialCacheHeader*)base;
+    if (!base || size < sizeof(MaterialCacheHeader) ||
+        header->magic != MATERIAL_CACHE_MAGIC || header->version != MATERIAL_CACHE_VERSION ||
+        header->sourceSize != sourceSize || header->sourceTime != sourceTime ||
+        sizeof(MaterialCacheHeader) + (std::uint64_t)header->count * sizeof(MaterialCacheRecord) + header->nameBytes > size) {
+        cacheFile.close();
+        return false;
+    }
+
+    const MaterialCacheRecord* records = (const MaterialCacheRecord*)(base + sizeof(MaterialCacheHeader));
+    const char* nameBlock = (const char*)(records + header->count);
+    if (header->nameBytes == 0 || nameBlock[header->nameBytes - 1] != '\0') {
+        cacheFile.close();
+        return false;
+    }
+
+    types.resize(header->count);
+    for (std::uint32_t i = 0; i < header->count; i++) {
+        if (records[i].nameOffset >= header->nameBytes) {
+            cacheFile.close();
+            types.clear();
+            return false;
+        }
+        PixelType& type = types[i];
+        type.Name = nameBlock + records[i].nameOffset;
+        type.LowestHeatOfCombustion_kJ_per_kg = records[i].lowestHeatOfCombustion;
+        type.LinearFlameSpeed = records[i].linearFlameSpeed;
+        type.BurningRate = records[i].burningRate;
+        type.SmokeGeneration = records[i].smokeGeneration;
+        type.OxygenConsumption_kg_per_kg = records[i].oxygenConsumption;
+        type.GasEmission.CarbonDioxide_kg_per_kg = records[i].carbonDioxide;
+        type.GasEmission.CarbonMonoxide_kg_per_kg = records[i].carbonMonoxide;
+        type.GasEmission.HydrogenChloride_kg_per_kg = records[i].hydrogenChloride;
+    }
+    indexNames();
+    cached = true;
+    return true;
+}
+
+bool MaterialRegistry::writeCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime) const {
+    std::string temporary = MappedFile::temporaryPath(path);
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+
+    MaterialCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MATERIAL_CACHE_MAGIC;
+    header.version = MATERIAL_CACHE_VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.count = (std::uint32_t)types.size();
+    header.nameBytes = (std::uint32_t)names.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (std::size_t i = 0; i < types.size(); i++) {
+        const PixelType& type = types[i];
+        MaterialCacheRecord record;
+        memset(&record, 0, sizeof(record));
+        record.lowestHeatOfCombustion = type.LowestHeatOfCombustion_kJ_per_kg;
+        record.linearFlameSpeed = type.LinearFlameSpeed;
+        record.burningRate = type.BurningRate;
+        record.smokeGeneration = type.SmokeGeneration;
+        record.oxygenConsumption = type.OxygenConsumption_kg_per_kg;
+        record.carbonDioxide = type.GasEmission.CarbonDioxide_kg_per_kg;
+        record.carbonMonoxide = type.GasEmission.CarbonMonoxide_kg_per_kg;
+        record.hydrogenChloride = type.GasEmission.HydrogenChloride_kg_per_kg;
+        record.nameOffset = nameOffsets[i];
+        ok = ok && fwrite(&record, sizeof(record), 1, file) == 1;
+    }
+    if (!names.empty()) ok = ok && fwrite(names.data(), 1, names.size(), file) == names.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        remove(temporary.c_str());
+        return false;
+    }
+    return MappedFile::replace(temporary.c_str(), path);
+}
+
+void MaterialRegistry::indexNames() {
+    byName.clear();
+    for (std::size_t i = 0; i < types.size(); i++) byName.emplace(types[i].Name, (MaterialId)i);
+}
+
+MaterialId MaterialRegistry::find(const char* name) const {
+    std::unordered_map<std::string, MaterialId>::const_iterator it = byName.find(name);
+    return it == byName.end() ? NO_MATERIAL : it->second;
+}
@@ -0,0 +1,68 @@
+#ifndef MATERIALREGISTRY_H
+#define MATERIALREGISTRY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+
+struct PixelType {
+    const char* Name;
+    double LowestHeatOfCombustion_kJ_per_kg;
+    double LinearFlameSpeed;
+    double BurningRate;
+    double SmokeGeneration;
+    double OxygenConsumption_kg_per_kg;
+    struct GasEmission {
+        double CarbonDioxide_kg_per_kg;
+        double CarbonMonoxide_kg_per_kg;
+        double HydrogenChloride_kg_per_kg;
+    } GasEmission;
+};
+
+// Номер материала - позиция в fire.json
+typedef std::uint16_t MaterialId;
+const MaterialId NO_MATERIAL = 0xFFFF;
+
+// Реестр материалов (типов клеток). Загружается один раз на процесс и потом
+// только читается, его делят все прогоны ансамбля. Названия хранятся в
+// одном блоке внутри реестра, PixelType::Name действителен, пока жив реестр.
+//
+// Разобранная таблица пишется в двоичный кэш (<путь>.cache, версия
+// MATERIAL_CACHE_VERSION). Кэш отображается в память, названия читаются
+// прямо из него; кэш пересобирается, если у json изменились размер или время
+// записи (в наносекундах). Новый кэш заменяет старый целиком (MappedFile::replace).
+class MaterialRegistry {
+public:
+    // Общий реестр файла path: первый вызов загружает, следующие возвращают тот же.
+    // nullptr - файл не прочитан
+    static std::shared_ptr<const MaterialRegistry> shared(const std::string& path);
+
+    bool load(const char* path, const char* cachePath = nullptr);
+
+    int size() const { return (int)types.size(); }
+    bool contains(int id) const { return id >= 0 && id < (int)types.size(); }
+    const PixelType& operator[](MaterialId id) const { return types[id]; }
+    // Номер типа из этого реестра
+    MaterialId idOf(const PixelType* type) const { return (MaterialId)(type - types.data()); }
+    // NO_MATERIAL, если такого названия нет
+    MaterialId find(const char* name) const;
+    bool fromCache() const { return cached; }
+
+private:
+    bool parse(const char* path);
+    bool readCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime);
+    bool writeCache(const char* path, std::uint64_t sourceSize, std::int64_t sourceTime) const;
+    void indexNames();
+
+    std::vector<PixelType> types;
+    std::vector<char> names;         // названия через '\0', если разбирали json
+    std::vector<std::uint32_t> nameOffsets;
+    MappedFile cacheFile;            // названия из кэша смотрят в этот файл
+    std::unordered_map<std::string, MaterialId> byName;
+    bool cached = false;
+};
+
+#endif // MATERIALREGISTRY_H
@@ -0,0 +1,74 @@
+#include "SlabDomains.h"
+#include <algorithm>
+
+void SlabDomains::reset(int slabs, int height, int width, int depth, int align) {
+    h = height;
+    w = width;
+    d = depth;
+    if (align <= 0) align = 1;
+    int tileRows = (height + align - 1) / align;
+    slabs = std::max(1, std::min(slabs, tileRows));
+
+    bounds.resize(slabs + 1);
+    for (int s = 0; s <= slabs; s++) {
+        bounds[s] = std::min(height, (int)((std::int64_t)tileRows * s / slabs) * align);
+    }
+    owner.resize(height);
+    for (int s = 0; s < slabs; s++) {
+        for (int x = bounds[s]; x < bounds[s + 1]; x++) owner[x] = s;
+    }
+    masks.clear();
+    masks.resize(slabs);
+    incoming.assign(slabs, std::vector<std::int32_t>());
+    queued.assign((std::size_t)slabs * 2 * depth, 0);
+    queuedRows = 0;
+    exchanged = 0;
+}
+
+// Свои строки и призрачные x = begin - 1, x = end
+void SlabDomains::allocate(int slab) {
+    int first = std::max(0, begin(slab) - 1);
+    int last = std::min(h, end(slab) + 1);
+    masks[slab].reset(last - first, w, d, first);
+}
+
+void SlabDomains::set(int x, int y, int z) {
+    masks[owner[x]].set(x, y, z);
+    touched(x, z);
+}
+
+void SlabDomains::clear(int x, int y, int z) {
+    masks[owner[x]].clear(x, y, z);
+    touched(x, z);
+}
+
+// Крайняя строка слоя - призрачная у соседа
+void SlabDomains::touched(int x, int z) {
+    int slab = owner[x];
+    if (x == begin(slab) && slab > 0) enqueue(slab - 1, 1, x, z);
+    if (x == end(slab) - 1 && slab + 1 < count()) enqueue(slab + 1, 0, x, z);
+}
+
+void SlabDomains::enqueue(int slab, int side, int x, int z) {
+    std::uint8_t& flag = queued[((std::size_t)slab * 2 + side) * d + z];
+    if (flag) return;
+    flag = 1;
+    incoming[slab].push_back((std::int32_t)((std::int64_t)x * d + z));
+    queuedRows++;
+}
+
+void SlabDomains::exchange(int slab) {
+    std::vector<std::int32_t>& rows = incoming[slab];
+    for (std::int32_t row : rows) {
+        int x = row / d;
+        int z = row % d;
+        masks[slab].copyRow(masks[owner[x]], x, z);
+        queued[((std::size_t)slab * 2 + (x < begin(slab) ? 0 : 1)) * d + z] = 0;
+    }
+    rows.clear();
+}
+
+void SlabDomains::finishExchange() {
+    exchanged += queuedRows;
+    queuedRows = 0;
+}
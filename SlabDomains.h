@@ -0,0 +1,56 @@
+#ifndef SLABDOMAINS_H
+#define SLABDOMAINS_H
+
+#include <cstdint>
+#include <vector>
+#include "FireKernels.h"
+
+// Разбиение сетки на слои по x (slab) между потоками пула. У каждого слоя
+// своя маска горящих клеток: его строки и по призрачной строке с каждой
+// стороны - копии крайних строк соседей. Запись идёт в маску владельца
+// строки; изменившиеся крайние строки копируются соседу в exchange(),
+// строки без изменений не пересылаются. Остальное состояние движка слои
+// не делят.
+class SlabDomains {
+public:
+    // slabs слоёв, границы кратны align (высоте тайла). Маски не выделяются
+    void reset(int slabs, int height, int width, int depth, int align);
+    // Маску слоя выделяет и обнуляет поток-владелец: страницы ложатся на его узел NUMA
+    void allocate(int slab);
+
+    int count() const { return (int)masks.size(); }
+    int begin(int slab) const { return bounds[slab]; }
+    int end(int slab) const { return bounds[slab + 1]; }
+    int slabOf(int x) const { return owner[x]; }
+    const BurningMask& maskAt(int x) const { return masks[owner[x]]; }
+
+    void set(int x, int y, int z);
+    void clear(int x, int y, int z);
+
+    // Есть строки для обмена
+    bool pending() const { return queuedRows > 0; }
+    // Скопировать в призрачные строки слоя изменившиеся крайние строки соседей.
+    // Слои обмениваются параллельно, каждый пишет только в свою маску;
+    // после всех слоёв - finishExchange()
+    void exchange(int slab);
+    void finishExchange();
+    // Строк передано с начала счёта
+    std::int64_t exchangedRows() const { return exchanged; }
+
+private:
+    void touched(int x, int z);
+    void enqueue(int slab, int side, int x, int z);
+
+    int h = 0;
+    int w = 0;
+    int d = 0;
+    std::vector<int> owner;  // слой по x
+    std::vector<int> bounds; // count() + 1 границ
+    std::vector<BurningMask> masks;
+    std::vector<std::vector<std::int32_t>> incoming; // по слою-получателю: строки x * depth + z
+    std::vector<std::uint8_t> queued;                // по получателю, стороне и z
+    int queuedRows = 0;
+    std::int64_t exchanged = 0;
+};
+
+#endif // SLABDOMAINS_H
@@ -0,0 +1,372 @@
+#include "SmokeField.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SMOKE_FIELD_SSE 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+// Видимость по оптической плотности дыма: l = 2.38 / mu
+static const double VISIBILITY_FACTOR = 2.38;
+
+// Пределы полей на клетку (масса в объёме клетки)
+static const double LIMITS[GAS_COUNT] = {
+    VISIBILITY_FACTOR / CRITICAL_VISIBILITY * CELL_VOLUME,
+    (AMBIENT_O2 - CRITICAL_O2) * CELL_VOLUME,
+    CRITICAL_CO2 * CELL_VOLUME,
+    CRITICAL_CO * CELL_VOLUME,
+    CRITICAL_HCL * CELL_VOLUME,
+};
+
+void SmokeField::allocate(int height, int width, int depth, int timeScale) {
+    clear();
+    h = height;
+    w = width;
+    d = depth;
+    timeSpeed = timeScale;
+    isa = detectKernelIsa();
+    std::size_t rowCount = (std::size_t)h * d;
+    openCells.assign((rowCount * w + 63) / 64, 0);
+    table.resize(rowCount);
+    zeros.assign(w + 2, 0.0f);
+    rowOpen.assign(rowCount, 0);
+    rowActive.assign(rowCount, 0);
+    rowQueued.assign(rowCount, 0);
+}
+
+void SmokeField::clear() {
+    h = w = d = 0;
+    current = 0;
+    openCells.clear();
+    table.clear();
+    rowsAllocated = 0;
+    zeros.clear();
+    rowOpen.clear();
+    rowActive.clear();
+    rowQueued.clear();
+    activeRows.clear();
+    yieldTypes.clear();
+    yieldTable.clear();
+    rows.clear();
+    retired.clear();
+    rowPeaks.clear();
+    rowBlocked.clear();
+    last = SmokeStats();
+}
+
+std::size_t SmokeField::bytes() const {
+    std::size_t perRow = (std::size_t)(2 * GAS_COUNT + 1) * (w + 2) * sizeof(float) + (std::size_t)w * sizeof(std::int32_t);
+    return rowsAllocated * (perRow + sizeof(Row)) + table.size() * sizeof(table[0]) + openCells.size() * sizeof(std::uint64_t);
+}
+
+// Строка заводится с нулевыми полями. Новое значение клетки
+// c + k * o * сумма o_n * (c_n - c) по шести соседям; в закрытых клетках
+// газа нет, поэтому это keep * c + gain * сумма c_n, где keep = 1 - k * (число
+// открытых соседей) и gain = k у открытой клетки, у закрытой оба 0. При
+// k < 1/6 keep открытой клетки больше нуля, и gain хранить не нужно:
+// это k там, где keep > 0
+SmokeField::Row& SmokeField::touch(std::size_t index) {
+    std::unique_ptr<Row>& slot = table[index];
+    if (slot) return *slot;
+    slot.reset(new Row());
+    Row& row = *slot;
+    row.values.reset(new float[(std::size_t)(2 * GAS_COUNT + 1) * (w + 2)]());
+    row.blocked.reset(new std::int32_t[w]);
+    std::fill(row.blocked.get(), row.blocked.get() + w, -1);
+
+    int x = (int)(index / d);
+    int z = (int)(index % d);
+    float* keep = array(row, KEEP);
+    const float k = (float)SMOKE_DIFFUSION;
+    for (int y = 0; y < w; y++) {
+        if (!isOpen(x, y, z)) continue;
+        int neighbours = (y > 0 && isOpen(x, y - 1, z)) + (y + 1 < w && isOpen(x, y + 1, z)) +
+                         (x > 0 && isOpen(x - 1, y, z)) + (x + 1 < h && isOpen(x + 1, y, z)) +
+                         (z > 0 && isOpen(x, y, z - 1)) + (z + 1 < d && isOpen(x, y, z + 1));
+        keep[y] = 1.0f - k * neighbours;
+    }
+    rowsAllocated++;
+    return row;
+}
+
+void SmokeField::addSource(int x, int y, int z, int burnStart, double fuel, double coefficient, const PixelType& type) {
+    if (!isOpen(x, y, z) || !(coefficient > 0) || !(fuel > 0)) return;
+    std::size_t index = rowIndex(x, z);
+    Row& row = touch(index);
+    // Материалов горит немного: выделения хранятся раз на тип
+    std::size_t material = std::find(yieldTypes.begin(), yieldTypes.end(), &type) - yieldTypes.begin();
+    if (material == yieldTypes.size()) {
+        yieldTypes.push_back(&type);
+        // OxygenConsumption в таблице отрицательный: кислород убывает
+        const double yields[GAS_COUNT] = {type.SmokeGeneration, -type.OxygenConsumption_kg_per_kg,
+                                          type.GasEmission.CarbonDioxide_kg_per_kg,
+                                          type.GasEmission.CarbonMonoxide_kg_per_kg,
+                                          type.GasEmission.HydrogenChloride_kg_per_kg};
+        yieldTable.insert(yieldTable.end(), yields, yields + GAS_COUNT);
+    }
+    row.sources.push_back(Source{y, (std::int32_t)material, (double)timeSpeed * burnStart, fuel, coefficient});
+    if (!rowActive[index]) {
+        rowActive[index] = 1;
+        activeRows.push_back((std::int32_t)index);
+    }
+}
+
+double SmokeField::visibility(int x, int y, int z) const {
+    double mu = concentration(GAS_SMOKE, x, y, z);
+    return mu > 0 ? VISIBILITY_FACTOR / mu : std::numeric_limits<double>::infinity();
+}
+
+// keep * c + gain * (сумма шести соседей), gain = k там, где keep > 0;
+// значения не выше floor - ноль.
+// Возвращает максимум новой строки. out не пересекается с входами (второй
+// буфер). На x86 по четыре клетки SSE: максимум по строке компилятор сам
+// не векторизует, не зная, что NaN в полях не бывает. Порядок сложения
+// соседей одинаковый в SSE и в хвосте
+static float diffuseRow(const float* __restrict c, const float* __restrict cx0, const float* __restrict cx1,
+                        const float* __restrict cz0, const float* __restrict cz1, const float* __restrict keep,
+                        float k, float* __restrict out, int width, float floor) {
+    int y = 0;
+    float peak = 0.0f;
+#ifdef SMOKE_FIELD_SSE
+    const __m128 floors = _mm_set1_ps(floor);
+    const __m128 ks = _mm_set1_ps(k);
+    __m128 peaks = _mm_setzero_ps();
+    for (; y + 4 <= width; y += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(c + y - 1), _mm_loadu_ps(c + y + 1));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(cx0 + y));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(cx1 + y));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(cz0 + y));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(cz1 + y));
+        __m128 keeps = _mm_loadu_ps(keep + y);
+        __m128 gain = _mm_and_ps(ks, _mm_cmpgt_ps(keeps, _mm_setzero_ps()));
+        __m128 value = _mm_add_ps(_mm_mul_ps(keeps, _mm_loadu_ps(c + y)), _mm_mul_ps(gain, sum));
+        value = _mm_and_ps(value, _mm_cmpgt_ps(value, floors));
+        _mm_storeu_ps(out + y, value);
+        peaks = _mm_max_ps(peaks, value);
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, peaks);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+    for (; y < width; y++) {
+        float sum = c[y - 1] + c[y + 1];
+        sum += cx0[y];
+        sum += cx1[y];
+        sum += cz0[y];
+        sum += cz1[y];
+        float gain = keep[y] > 0 ? k : 0.0f;
+        float value = keep[y] * c[y] + gain * sum;
+        out[y] = value > floor ? value : 0.0f;
+        peak = std::max(peak, out[y]);
+    }
+    return peak;
+}
+
+// То же по восемь клеток. Без FMA: результат совпадает с SSE и хвостом
+#ifdef SMOKE_FIELD_SSE
+static TARGET_AVX2 float diffuseRowAvx2(const float* __restrict c, const float* __restrict cx0,
+                                        const float* __restrict cx1, const float* __restrict cz0,
+                                        const float* __restrict cz1, const float* __restrict keep, float k,
+                                        float* __restrict out, int width, float floor) {
+    int y = 0;
+    const __m256 floors = _mm256_set1_ps(floor);
+    const __m256 ks = _mm256_set1_ps(k);
+    __m256 peaks = _mm256_setzero_ps();
+    for (; y + 8 <= width; y += 8) {
+        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(c + y - 1), _mm256_loadu_ps(c + y + 1));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(cx0 + y));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(cx1 + y));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(cz0 + y));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(cz1 + y));
+        __m256 keeps = _mm256_loadu_ps(keep + y);
+        __m256 gain = _mm256_and_ps(ks, _mm256_cmp_ps(keeps, _mm256_setzero_ps(), _CMP_GT_OQ));
+        __m256 value = _mm256_add_ps(_mm256_mul_ps(keeps, _mm256_loadu_ps(c + y)), _mm256_mul_ps(gain, sum));
+        value = _mm256_and_ps(value, _mm256_cmp_ps(value, floors, _CMP_GT_OQ));
+        _mm256_storeu_ps(out + y, value);
+        peaks = _mm256_max_ps(peaks, value);
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, peaks);
+    float peak = 0.0f;
+    for (int i = 0; i < 8; i++) peak = std::max(peak, lanes[i]);
+    for (; y < width; y++) {
+        float sum = c[y - 1] + c[y + 1];
+        sum += cx0[y];
+        sum += cx1[y];
+        sum += cz0[y];
+        sum += cz1[y];
+        float gain = keep[y] > 0 ? k : 0.0f;
+        float value = keep[y] * c[y] + gain * sum;
+        out[y] = value > floor ? value : 0.0f;
+        peak = std::max(peak, out[y]);
+    }
+    return peak;
+}
+#endif
+
+// Шаг одной строки: все поля в новый буфер, затем выделение горящих клеток
+// строки за этот шаг, пока строка в кэше, пики полей в peaks. Выделение -
+// разность min(fuel, coefficient * t³) в начале и в конце шага, как у
+// burntMass; выгоревший источник уходит. Поклеточная проверка только там,
+// где есть превышение и ещё не заблокированные открытые клетки. Возвращает
+// число клеток, заблокированных на этом шаге
+int SmokeField::diffuse(std::int32_t index, int step, const float* limits, const float* floors, float* peaks) {
+    Row& row = *table[index];
+    int x = index / d;
+    int z = index % d;
+    // Соседняя строка; вне сетки и незаведённая - без газа
+    auto neighbour = [&](int nx, int nz) -> const Row* {
+        if (nx < 0 || nx >= h || nz < 0 || nz >= d) return nullptr;
+        return table[rowIndex(nx, nz)].get();
+    };
+    auto values = [&](const Row* other, int s) -> const float* {
+        return other ? field(*other, current, s) : zeros.data() + 1;
+    };
+    const Row* x0 = neighbour(x - 1, z);
+    const Row* x1 = neighbour(x + 1, z);
+    const Row* z0 = neighbour(x, z - 1);
+    const Row* z1 = neighbour(x, z + 1);
+    const float* keep = array(row, KEEP);
+    const float k = (float)SMOKE_DIFFUSION;
+    float* next[GAS_COUNT];
+    for (int s = 0; s < GAS_COUNT; s++) {
+        const float* c = field(row, current, s);
+        next[s] = field(row, current ^ 1, s);
+#ifdef SMOKE_FIELD_SSE
+        if (isa != KernelIsa::Scalar) {
+            peaks[s] = diffuseRowAvx2(c, values(x0, s), values(x1, s), values(z0, s), values(z1, s), keep, k, next[s], w, floors[s]);
+            continue;
+        }
+#endif
+        peaks[s] = diffuseRow(c, values(x0, s), values(x1, s), values(z0, s), values(z1, s), keep, k, next[s], w, floors[s]);
+    }
+
+    double now = (double)timeSpeed * step;
+    for (std::size_t i = row.sources.size(); i-- > 0;) {
+        const Source& source = row.sources[i];
+        double t = now - source.origin;
+        double end = t + timeSpeed;
+        double before = std::min(source.fuel, source.coefficient * (t * t * t));
+        double after = std::min(source.fuel, source.coefficient * (end * end * end));
+        const double* yields = &yieldTable[(std::size_t)source.material * GAS_COUNT];
+        for (int s = 0; s < GAS_COUNT; s++) {
+            float& value = next[s][source.y];
+            value += (float)((after - before) * yields[s]);
+            peaks[s] = std::max(peaks[s], value);
+        }
+        if (after >= source.fuel) {
+            row.sources[i] = row.sources.back();
+            row.sources.pop_back();
+        }
+    }
+
+    bool untenable = false;
+    for (int s = 0; s < GAS_COUNT; s++) untenable = untenable || peaks[s] > limits[s];
+    if (!untenable || row.blockedCount >= rowOpen[index]) return 0;
+
+    std::int32_t* block = row.blocked.get();
+    int blocked = 0;
+    for (int y = 0; y < w; y++) {
+        if (block[y] >= 0) continue;
+        bool exceeded = false;
+        for (int s = 0; s < GAS_COUNT; s++) exceeded = exceeded || next[s][y] > limits[s];
+        if (!exceeded) continue;
+        block[y] = step;
+        blocked++;
+    }
+    row.blockedCount += blocked;
+    return blocked;
+}
+
+void SmokeField::advance(int step, ThreadPool& pool) {
+    if (h == 0) return;
+
+    // Строки шага: газ уже есть или может прийти от соседней строки.
+    // Строки из одних стен не заводятся
+    rows.clear();
+    for (std::int32_t row : activeRows) {
+        int x = row / d;
+        int z = row % d;
+        const int DX[5] = {0, -1, 1, 0, 0};
+        const int DZ[5] = {0, 0, 0, -1, 1};
+        for (int n = 0; n < 5; n++) {
+            int nx = x + DX[n];
+            int nz = z + DZ[n];
+            if (nx < 0 || nx >= h || nz < 0 || nz >= d) continue;
+            std::size_t neighbour = rowIndex(nx, nz);
+            if (rowQueued[neighbour] || rowOpen[neighbour] == 0) continue;
+            rowQueued[neighbour] = 1;
+            touch(neighbour);
+            rows.push_back((std::int32_t)neighbour);
+        }
+    }
+    // По порядку строк соседи (x, z +- 1) и (x +- 1, z) прочитаны недавно
+    // и ещё в кэше; в порядке активации каждая строка читалась бы из памяти
+    std::sort(rows.begin(), rows.end());
+
+    // Диффузия, выделение и проверка условий строка за строкой.
+    // Строка пишет только свой новый буфер и свои времена блокирования,
+    // поэтому строки идут параллельно; пики и число новых блокировок
+    // собираются после
+    float limits[GAS_COUNT];
+    float floors[GAS_COUNT];
+    for (int s = 0; s < GAS_COUNT; s++) {
+        limits[s] = (float)LIMITS[s];
+        floors[s] = (float)(LIMITS[s] * GAS_FLOOR);
+    }
+    rowPeaks.resize(rows.size() * GAS_COUNT);
+    rowBlocked.resize(rows.size());
+    pool.parallelFor((std::int64_t)rows.size(), 16, [&](std::int64_t begin, std::int64_t end) {
+        for (std::int64_t r = begin; r < end; r++) rowBlocked[r] = diffuse(rows[r], step, limits, floors, &rowPeaks[r * GAS_COUNT]);
+    });
+
+    SmokeStats stats;
+    stats.untenableCells = last.untenableCells;
+    float maxima[GAS_COUNT] = {};
+    retired.clear();
+    for (std::size_t r = 0; r < rows.size(); r++) {
+        std::int32_t index = rows[r];
+        rowQueued[index] = 0;
+        stats.untenableCells += rowBlocked[r];
+        // Строка с горящими клетками из счёта не выходит
+        bool any = !table[index]->sources.empty();
+        for (int s = 0; s < GAS_COUNT; s++) {
+            maxima[s] = std::max(maxima[s], rowPeaks[r * GAS_COUNT + s]);
+            any = any || rowPeaks[r * GAS_COUNT + s] > 0;
+        }
+        if (any && !rowActive[index]) {
+            rowActive[index] = 1;
+            activeRows.push_back(index);
+        } else if (!any && rowActive[index]) {
+            rowActive[index] = 0;
+            retired.push_back(index);
+        }
+    }
+    // Строки вне шага нулевые в обоих буферах. У вышедших из счёта новый
+    // буфер уже нулевой, старый обнуляется здесь, после всех соседей
+    for (std::int32_t index : retired) {
+        for (int s = 0; s < GAS_COUNT; s++) std::memset(field(*table[index], current, s), 0, w * sizeof(float));
+    }
+    if (!retired.empty()) {
+        activeRows.erase(std::remove_if(activeRows.begin(), activeRows.end(),
+                                        [this](std::int32_t index) { return !rowActive[index]; }),
+                         activeRows.end());
+    }
+    current ^= 1;
+
+    stats.minVisibility = maxima[GAS_SMOKE] > 0 ? VISIBILITY_FACTOR * CELL_VOLUME / maxima[GAS_SMOKE] : 0;
+    // Стоков у газов нет, дефицит кислорода может превысить его запас
+    stats.minOxygen = std::max(0.0, AMBIENT_O2 - maxima[GAS_O2_DEFICIT] / CELL_VOLUME);
+    stats.maxCO2 = maxima[GAS_CO2] / CELL_VOLUME;
+    stats.maxCO = maxima[GAS_CO] / CELL_VOLUME;
+    stats.maxHCl = maxima[GAS_HCL] / CELL_VOLUME;
+    last = stats;
+}
@@ -0,0 +1,160 @@
+#ifndef SMOKEFIELD_H
+#define SMOKEFIELD_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FireKernels.h"
+#include "MaterialRegistry.h"
+#include "ThreadPool.h"
+
+// Поля дыма и газов: оптическая плотность дыма и массовые концентрации
+// O2, CO2, CO, HCl в каждой клетке. Источник - масса, выгоревшая за шаг,
+// умноженная на удельные выделения материала (PixelType). Перенос - явная
+// диффузия по соседям по граням; через стены потока нет.
+//
+// Память - по строкам (x, z, 0..width-1): строка заводится, когда к ней
+// подходит газ, и держит оба буфера всех полей (SoA, по float на клетку и
+// поле) с нулём по краям, так что внутренний цикл по строке не проверяет
+// границ и идёт по восемь клеток (AVX2) или по четыре (SSE). Считаются
+// только строки с газом и их соседи; строка, где все поля упали ниже порога
+// (миллионная доля критического значения), из счёта выходит. Части здания,
+// куда газ не дошёл, памяти не занимают.
+//
+// Источники - горящие клетки (addSource): выделение считается в advance
+// вместе с диффузией строки, пока строка в кэше, а не отдельным обходом
+// фронта. Шаг - перенос, затем выделение этого шага (расщепление):
+// поля после шага содержат весь газ, выделенный по этот шаг включительно.
+//
+// Критические значения (предельно допустимые для людей) - по методике
+// определения расчётных величин пожарного риска.
+enum GasSpecies { GAS_SMOKE, GAS_O2_DEFICIT, GAS_CO2, GAS_CO, GAS_HCL, GAS_COUNT };
+
+const double CELL_VOLUME = 1.0;            // м³ на клетку, условно
+const double AMBIENT_O2 = 0.273;           // кг/м³ в чистом воздухе
+const double SMOKE_DIFFUSION = 0.1;        // доля перепада за шаг, < 1/6 для устойчивости
+const double CRITICAL_VISIBILITY = 20;     // м
+const double CRITICAL_O2 = 0.226;          // кг/м³, не меньше
+const double CRITICAL_CO2 = 0.11;          // кг/м³, не больше
+const double CRITICAL_CO = 1.16e-3;        // кг/м³
+const double CRITICAL_HCL = 23e-6;         // кг/м³
+const double GAS_FLOOR = 1e-6;             // доля критического значения, ниже - ноль
+
+// Худшие значения по сетке после шага
+struct SmokeStats {
+    int untenableCells = 0;        // клеток, где условия хоть раз были опасны
+    double minVisibility = 0;      // м, 0 - дыма нет нигде (бесконечность)
+    double minOxygen = AMBIENT_O2;
+    double maxCO2 = 0;
+    double maxCO = 0;
+    double maxHCl = 0;
+};
+
+class SmokeField {
+public:
+    // passable(x, y, z) - клетка открыта для газа (не стена);
+    // timeSpeed - единиц времени горения за шаг (TIME_SPEED)
+    template <class Passable>
+    void reset(int height, int width, int depth, int timeSpeed, Passable passable) {
+        allocate(height, width, depth, timeSpeed);
+        for (int x = 0; x < h; x++) {
+            for (int z = 0; z < d; z++) {
+                for (int y = 0; y < w; y++) {
+                    if (!passable(x, y, z)) continue;
+                    std::size_t cell = rowIndex(x, z) * w + y;
+                    openCells[cell >> 6] |= (std::uint64_t)1 << (cell & 63);
+                    rowOpen[rowIndex(x, z)]++;
+                }
+            }
+        }
+    }
+    void clear();
+
+    // Клетка загорелась на шаге burnStart: на шаге n она выделяет разность
+    // min(fuel, coefficient * t³) между t = T * (n - burnStart) и
+    // T * (n + 1 - burnStart), T = timeSpeed, как burntMass движка. Источник
+    // уходит сам, когда запас выгорел. Газ горящей стены в расчёт не идёт
+    void addSource(int x, int y, int z, int burnStart, double fuel, double coefficient, const PixelType& type);
+    // Шаг диффузии, выделение источников и проверка условий; step - номер
+    // шага для выделения и времени блокирования. Строки делятся между
+    // потоками pool, как строки fp в шаге огня
+    void advance(int step, ThreadPool& pool);
+
+    bool isEmpty() const { return h == 0; }
+    double concentration(GasSpecies species, int x, int y, int z) const {
+        const Row* row = table[rowIndex(x, z)].get();
+        return row ? field(*row, current, species)[y] / CELL_VOLUME : 0.0;
+    }
+    // Стока у газов нет: кислород не опускается ниже нуля
+    double oxygen(int x, int y, int z) const {
+        double value = AMBIENT_O2 - concentration(GAS_O2_DEFICIT, x, y, z);
+        return value > 0 ? value : 0;
+    }
+    // Дальность видимости, м; бесконечность, если дыма нет
+    double visibility(int x, int y, int z) const;
+    // Шаг, на котором условия в клетке впервые стали опасными, -1 - не становились
+    int blockingStep(int x, int y, int z) const {
+        const Row* row = table[rowIndex(x, z)].get();
+        return row ? row->blocked[y] : -1;
+    }
+    const SmokeStats& stats() const { return last; }
+    // Заведённых строк и байт под них
+    std::size_t rowsInUse() const { return rowsAllocated; }
+    std::size_t bytes() const;
+
+private:
+    // Горящая клетка y строки: начало горения в единицах времени, запас,
+    // коэффициент t³ и номер материала в yieldTable
+    struct Source {
+        std::int32_t y;
+        std::int32_t material;
+        double origin;
+        double fuel;
+        double coefficient;
+    };
+    // Строка сетки газов. values - два буфера по GAS_COUNT полей, затем keep;
+    // каждый массив w + 2 float, клетка y лежит по индексу y + 1
+    struct Row {
+        std::unique_ptr<float[]> values;
+        std::unique_ptr<std::int32_t[]> blocked;
+        std::vector<Source> sources;
+        std::int32_t blockedCount = 0; // клеток с временем блокирования
+    };
+    // Массивы строки: поле species буфера buffer и keep
+    static const int KEEP = 2 * GAS_COUNT;
+
+    void allocate(int height, int width, int depth, int timeSpeed);
+    std::size_t rowIndex(int x, int z) const { return (std::size_t)x * d + z; }
+    float* array(const Row& row, int index) const { return row.values.get() + (std::size_t)index * (w + 2) + 1; }
+    float* field(const Row& row, int buffer, int species) const { return array(row, buffer * GAS_COUNT + species); }
+    bool isOpen(int x, int y, int z) const {
+        std::size_t cell = rowIndex(x, z) * w + y;
+        return openCells[cell >> 6] >> (cell & 63) & 1;
+    }
+    Row& touch(std::size_t row);
+    int diffuse(std::int32_t index, int step, const float* limits, const float* floors, float* peaks);
+
+    int h = 0;
+    int w = 0;
+    int d = 0;
+    int timeSpeed = 1;
+    int current = 0;                         // буфер с полями последнего шага
+    KernelIsa isa = KernelIsa::Scalar;       // не Scalar - диффузия по восемь клеток (AVX2)
+    std::vector<std::uint64_t> openCells;    // биты открытых клеток по rowIndex * w + y
+    std::vector<std::unique_ptr<Row>> table; // по rowIndex; nullptr - газа не было
+    std::size_t rowsAllocated = 0;
+    std::vector<float> zeros;                // строка без газа: соседи вне сетки и незаведённые
+    std::vector<std::int32_t> rowOpen;       // открытых клеток строки: стены не блокируются
+    std::vector<std::uint8_t> rowActive;     // в строке есть газ
+    std::vector<std::uint8_t> rowQueued;
+    std::vector<std::int32_t> activeRows;
+    std::vector<const PixelType*> yieldTypes; // материалы источников
+    std::vector<double> yieldTable;          // выделения на кг по материалам, GAS_COUNT подряд
+    std::vector<std::int32_t> rows;          // строки шага: активные и их соседи
+    std::vector<std::int32_t> retired;       // строки, где газ кончился на этом шаге
+    std::vector<float> rowPeaks;             // по строкам шага: пики полей
+    std::vector<std::int32_t> rowBlocked;    // по строкам шага: новых блокировок
+    SmokeStats last;
+};
+
+#endif // SMOKEFIELD_H
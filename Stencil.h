@@ -0,0 +1,77 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <array>
+#include <cstdint>
+#include "FireKernels.h"
+
+// Окрестность распространения огня: соседи по граням (фон Нейман) или
+// все соседи куба 3x3(x3) (Мур)
+enum Neighbourhood { VON_NEUMANN, MOORE };
+
+struct StencilOffset {
+    int dx;
+    int dy;
+    int dz;
+};
+
+// Смещения окрестности, считаются при компиляции. На плоскости dz = 0
+template <int Dims, Neighbourhood Kind, std::size_t Count>
+constexpr std::array<StencilOffset, Count> stencilOffsets() {
+    std::array<StencilOffset, Count> offsets{};
+    std::size_t n = 0;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dz = (Dims == 3 ? -1 : 0); dz <= (Dims == 3 ? 1 : 0); dz++) {
+                int nonzero = (dx != 0) + (dy != 0) + (dz != 0);
+                if (nonzero == 0 || (Kind == VON_NEUMANN && nonzero != 1)) continue;
+                offsets[n++] = StencilOffset{dx, dy, dz};
+            }
+        }
+    }
+    return offsets;
+}
+
+// Биты смещений FOOTPRINT (Мур), входящих в окрестность Kind; порядок
+// смещений у обеих окрестностей один, поэтому биты идут в порядке SPREAD
+template <int Dims, Neighbourhood Kind, std::size_t Count>
+constexpr std::uint32_t spreadMask() {
+    std::array<StencilOffset, Count> offsets = stencilOffsets<Dims, MOORE, Count>();
+    std::uint32_t mask = 0;
+    for (std::size_t k = 0; k < Count; k++) {
+        int nonzero = (offsets[k].dx != 0) + (offsets[k].dy != 0) + (offsets[k].dz != 0);
+        if (Kind == MOORE || nonzero == 1) mask |= (std::uint32_t)1 << k;
+    }
+    return mask;
+}
+
+// Шаблон движка: размерность и окрестность распространения.
+// SPREAD - куда огонь переходит из нового очага (кандидаты CheckList),
+// FOOTPRINT - клетки, у которых меняется fp при смене состояния соседа
+// (fp всегда считается по окрестности Мура: 2 * a + b).
+template <int Dims, Neighbourhood Kind>
+struct Stencil {
+    static_assert(Dims == 2 || Dims == 3, "2D или 3D");
+
+    static constexpr int DIMENSIONS = Dims;
+    static constexpr std::size_t SPREAD_COUNT = Dims == 2 ? (Kind == MOORE ? 8 : 4) : (Kind == MOORE ? 26 : 6);
+    static constexpr std::size_t FOOTPRINT_COUNT = Dims == 2 ? 8 : 26;
+    static constexpr std::array<StencilOffset, SPREAD_COUNT> SPREAD = stencilOffsets<Dims, Kind, SPREAD_COUNT>();
+    static constexpr std::array<StencilOffset, FOOTPRINT_COUNT> FOOTPRINT = stencilOffsets<Dims, MOORE, FOOTPRINT_COUNT>();
+    static constexpr std::uint32_t SPREAD_MASK = spreadMask<Dims, Kind, FOOTPRINT_COUNT>();
+
+    static int fp(const BurningMask& mask, int x, int y, int z) {
+        if (Dims == 2) return mask.fpCellPlanar(x, y);
+        return mask.fpCell(x, y, z);
+    }
+    static void fpRow(const BurningMask& mask, int x, int z, std::uint8_t* out) {
+        if (Dims == 2) mask.fpRowPlanar(x, out);
+        else mask.fpRow(x, z, out);
+    }
+};
+
+// Прежний 3D движок и прежний 2D движок (FireSimulation_2D)
+typedef Stencil<3, MOORE> Moore3D;
+typedef Stencil<2, VON_NEUMANN> VonNeumann2D;
+
+#endif // STENCIL_H
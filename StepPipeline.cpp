@@ -0,0 +1,134 @@
+#include "StepPipeline.h"
+#include <chrono>
+#include "FireSimulation.h"
+
+// Ожидание очереди: сначала уступить процессор, потом спать по миллисекунде
+static void backOff(int& spins) {
+    if (++spins < 64) std::this_thread::yield();
+    else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+StepPipeline::~StepPipeline() {
+    stop();
+}
+
+void StepPipeline::addConsumer(StepConsumer* consumer, OverflowPolicy policy, int capacity) {
+    std::unique_ptr<Channel> channel(new Channel());
+    channel->consumer = consumer;
+    channel->policy = policy;
+    channel->slots.resize(capacity > 0 ? capacity : 1);
+    channels.push_back(std::move(channel));
+}
+
+void StepPipeline::start() {
+    stopping.store(false, std::memory_order_relaxed);
+    for (std::unique_ptr<Channel>& channel : channels) {
+        Channel* c = channel.get();
+        c->thread = std::thread([this, c] { consumerLoop(*c); });
+    }
+}
+
+void StepPipeline::publish(const StepChanges& record) {
+    for (std::unique_ptr<Channel>& channel : channels) {
+        Channel& c = *channel;
+        std::uint64_t head = c.head.load(std::memory_order_relaxed);
+        std::uint64_t capacity = c.slots.size();
+        if (head - c.tail.load(std::memory_order_acquire) == capacity) {
+            if (c.policy == OVERFLOW_DROP) {
+                c.dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            c.stalls++;
+            int spins = 0;
+            while (head - c.tail.load(std::memory_order_acquire) == capacity) backOff(spins);
+        }
+        // Присваивание переиспользует буфер изменений слота
+        StepChanges& slot = c.slots[head % capacity];
+        slot.step = record.step;
+        slot.candidates = record.candidates;
+        slot.burning = record.burning;
+        slot.ignited = record.ignited;
+        slot.burntOut = record.burntOut;
+        slot.burntTotal = record.burntTotal;
+        slot.peakBurning = record.peakBurning;
+        slot.peakStep = record.peakStep;
+        slot.changes.assign(record.changes.begin(), record.changes.end());
+        c.head.store(head + 1, std::memory_order_release);
+    }
+}
+
+void StepPipeline::consumerLoop(Channel& channel) {
+    std::uint64_t capacity = channel.slots.size();
+    int spins = 0;
+    for (;;) {
+        // Флаг читается до проверки очереди: записи, опубликованные до stop,
+        // будут дочитаны
+        bool last = stopping.load(std::memory_order_acquire);
+        std::uint64_t tail = channel.tail.load(std::memory_order_relaxed);
+        if (channel.head.load(std::memory_order_acquire) == tail) {
+            if (last) break;
+            backOff(spins);
+            continue;
+        }
+        spins = 0;
+        channel.consumer->consume(channel.slots[tail % capacity]);
+        channel.tail.store(tail + 1, std::memory_order_release);
+    }
+    channel.consumer->finish();
+}
+
+void StepPipeline::stop() {
+    stopping.store(true, std::memory_order_release);
+    for (std::unique_ptr<Channel>& channel : channels) {
+        if (channel->thread.joinable()) channel->thread.join();
+    }
+}
+
+ChangeLogWriter::~ChangeLogWriter() {
+    finish();
+}
+
+bool ChangeLogWriter::open(const char* path) {
+    finish();
+    file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "step,x,y,z,state\n");
+    return true;
+}
+
+void ChangeLogWriter::consume(const StepChanges& record) {
+    if (!file) return;
+    for (const CellUpdate& change : record.changes) {
+        fprintf(file, "%d,%d,%d,%d,%d\n", record.step, change.x, change.y, change.z, change.state);
+    }
+}
+
+void ChangeLogWriter::finish() {
+    if (file) fclose(file);
+    file = nullptr;
+}
+
+void StepStatistics::consume(const StepChanges& record) {
+    if (last >= 0 && record.step > last + 1) missed += record.step - last - 1;
+    last = record.step;
+    burnt = record.burntTotal;
+    peak = record.peakBurning;
+    peakAt = record.peakStep;
+}
+
+void RenderConsumer::start(int height, int width, const char* base, FILE* out) {
+    w = width;
+    cells.assign(base, base + (std::size_t)height * width);
+    renderer.start(height, width, out);
+}
+
+void RenderConsumer::consume(const StepChanges& record) {
+    for (const CellUpdate& change : record.changes) {
+        if (change.z == 0) cells[(std::size_t)change.x * w + change.y] = change.state == BURNING ? '*' : 'X';
+    }
+    renderer.publish(record.step, cells.data());
+}
+
+void RenderConsumer::finish() {
+    renderer.stop();
+}
@@ -0,0 +1,137 @@
+#ifndef STEPPIPELINE_H
+#define STEPPIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "FireView.h"
+#include "TerminalRenderer.h"
+
+// Всё, что вывод знает о шаге: счётчики и изменения клеток
+struct StepChanges {
+    int step = 0;
+    int candidates = 0;
+    int burning = 0;
+    int ignited = 0;
+    int burntOut = 0;
+    std::int64_t burntTotal = 0;
+    // Наибольшее burning с начала прогона и его шаг: копит симулятор, чтобы
+    // пик не терялся вместе с пропущенной записью
+    int peakBurning = 0;
+    int peakStep = -1;
+    std::vector<CellUpdate> changes;
+};
+
+// Потребитель шагов; consume и finish вызываются на его собственном потоке
+class StepConsumer {
+public:
+    virtual ~StepConsumer() {}
+    virtual void consume(const StepChanges& record) = 0;
+    // После последнего шага
+    virtual void finish() {}
+};
+
+// Что делать, когда очередь потребителя полна: ждать его (симулятор
+// замедляется до скорости потребителя) или пропустить шаг для него
+enum OverflowPolicy { OVERFLOW_BLOCK, OVERFLOW_DROP };
+
+// Конвейер вывода. У каждого потребителя свой поток и своя кольцевая очередь
+// на capacity шагов с одним писателем (симулятор) и одним читателем (поток
+// потребителя): индексы записи и чтения - атомарные счётчики, блокировок нет.
+// Буферы слотов переиспользуются, после разгона publish не выделяет памяти.
+class StepPipeline {
+public:
+    StepPipeline() = default;
+    ~StepPipeline();
+
+    StepPipeline(const StepPipeline&) = delete;
+    StepPipeline& operator=(const StepPipeline&) = delete;
+
+    // До start; потребитель должен жить до stop
+    void addConsumer(StepConsumer* consumer, OverflowPolicy policy, int capacity = 64);
+    void start();
+    // Копия записи в очередь каждого потребителя
+    void publish(const StepChanges& record);
+    // Потребители дочитывают очереди, затем finish и остановка потоков
+    void stop();
+
+    int consumerCount() const { return (int)channels.size(); }
+    // Шагов, пропущенных потребителем i (OVERFLOW_DROP)
+    std::int64_t dropped(int i) const { return channels[i]->dropped.load(std::memory_order_relaxed); }
+    // Сколько раз симулятор ждал потребителя i (OVERFLOW_BLOCK)
+    std::int64_t stalls(int i) const { return channels[i]->stalls; }
+
+private:
+    struct Channel {
+        StepConsumer* consumer;
+        OverflowPolicy policy;
+        std::vector<StepChanges> slots;
+        std::atomic<std::uint64_t> head{0}; // пишет только симулятор
+        std::atomic<std::uint64_t> tail{0}; // пишет только поток потребителя
+        std::atomic<std::int64_t> dropped{0};
+        std::int64_t stalls = 0;
+        std::thread thread;
+    };
+
+    void consumerLoop(Channel& channel);
+
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::atomic<bool> stopping{false};
+};
+
+// Журнал изменений клеток в CSV: step,x,y,z,state
+class ChangeLogWriter : public StepConsumer {
+public:
+    ~ChangeLogWriter();
+    bool open(const char* path);
+    void consume(const StepChanges& record) override;
+    void finish() override;
+
+private:
+    FILE* file = nullptr;
+};
+
+// Сводка прогона по накопленным счётчикам записи (burntTotal, peakBurning),
+// так что пропущенные шаги (OVERFLOW_DROP) не теряют ни выгоревших клеток,
+// ни пика
+class StepStatistics : public StepConsumer {
+public:
+    void consume(const StepChanges& record) override;
+
+    int lastStep() const { return last; }
+    int peakBurning() const { return peak; }
+    int peakStep() const { return peakAt; }
+    std::int64_t burntTotal() const { return burnt; }
+    // Шагов, которых не было в потоке записей
+    int missedSteps() const { return missed; }
+
+private:
+    int last = -1;
+    int peak = 0;
+    int peakAt = -1;
+    std::int64_t burnt = 0;
+    int missed = 0;
+};
+
+// Живая карта слоя z = 0: изменения накладываются на копию слоя, копия
+// уходит в TerminalRenderer. Изменения нужны все, поэтому OVERFLOW_BLOCK;
+// медленный терминал всё равно не тормозит, TerminalRenderer пропускает кадры
+class RenderConsumer : public StepConsumer {
+public:
+    // base - символы плана слоя, height * width
+    void start(int height, int width, const char* base, FILE* out = stdout);
+    void consume(const StepChanges& record) override;
+    void finish() override;
+
+    const TerminalRenderer& getRenderer() const { return renderer; }
+
+private:
+    int w = 0;
+    std::vector<char> cells;
+    TerminalRenderer renderer;
+};
+
+#endif // STEPPIPELINE_H
@@ -0,0 +1,125 @@
+#include "StepProfiler.h"
+#include <cstdio>
+
+static const char* const PHASE_NAMES[PHASE_COUNT] = {"ignite", "expand", "burn_out", "smoke", "output"};
+
+void StepProfiler::open(const char* csvPath, const char* tracePath) {
+    csv = csvPath ? csvPath : "";
+    trace = tracePath ? tracePath : "";
+    active = !csv.empty() || !trace.empty();
+    origin = std::chrono::steady_clock::now();
+    records.clear();
+}
+
+std::int64_t StepProfiler::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void StepProfiler::beginStep(int step) {
+    StepRecord record;
+    record.step = step;
+    record.begin = now();
+    record.end = record.begin;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        record.phaseBegin[p] = -1;
+        record.phaseTime[p] = 0;
+    }
+    record.candidates = record.burning = record.ignited = record.burntOut = 0;
+    records.push_back(record);
+}
+
+void StepProfiler::endStep(int candidates, int burning, int ignited, int burntOut) {
+    StepRecord& record = records.back();
+    record.end = now();
+    record.candidates = candidates;
+    record.burning = burning;
+    record.ignited = ignited;
+    record.burntOut = burntOut;
+}
+
+// Фаза может повторяться внутри шага: время складывается, начало - первое
+void StepProfiler::beginPhase(StepPhase phase) {
+    if (!active || records.empty()) return;
+    StepRecord& record = records.back();
+    std::int64_t t = now();
+    if (record.phaseBegin[phase] < 0) record.phaseBegin[phase] = t;
+    record.phaseTime[phase] -= t;
+}
+
+void StepProfiler::endPhase(StepPhase phase) {
+    if (!active || records.empty()) return;
+    records.back().phaseTime[phase] += now();
+}
+
+bool StepProfiler::write() {
+    if (!active || records.empty()) return true;
+    bool ok = true;
+    if (!csv.empty() && !writeCsv(csv.c_str())) {
+        printf("Не удалось записать профиль %s\n", csv.c_str());
+        ok = false;
+    }
+    if (!trace.empty() && !writeTrace(trace.c_str())) {
+        printf("Не удалось записать трассу %s\n", trace.c_str());
+        ok = false;
+    }
+    records.clear();
+    return ok;
+}
+
+bool StepProfiler::writeCsv(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "step,ignite_us,expand_us,burn_out_us,smoke_us,output_us,step_us,candidates,burning,ignited,burnt_out\n");
+    std::int64_t total[PHASE_COUNT] = {0};
+    std::int64_t totalStep = 0;
+    long long ignited = 0;
+    long long burntOut = 0;
+    int peakCandidates = 0;
+    int peakBurning = 0;
+    for (const StepRecord& record : records) {
+        fprintf(file, "%d", record.step);
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            fprintf(file, ",%.1f", record.phaseTime[p] / 1000.0);
+            total[p] += record.phaseTime[p];
+        }
+        std::int64_t end = record.phaseBegin[PHASE_OUTPUT] >= 0 ? record.end + record.phaseTime[PHASE_OUTPUT] : record.end;
+        totalStep += end - record.begin;
+        fprintf(file, ",%.1f,%d,%d,%d,%d\n", (end - record.begin) / 1000.0, record.candidates,
+                record.burning, record.ignited, record.burntOut);
+        ignited += record.ignited;
+        burntOut += record.burntOut;
+        if (record.candidates > peakCandidates) peakCandidates = record.candidates;
+        if (record.burning > peakBurning) peakBurning = record.burning;
+    }
+    // Итог: суммы времени и событий, пики фронта
+    fprintf(file, "total");
+    for (int p = 0; p < PHASE_COUNT; p++) fprintf(file, ",%.1f", total[p] / 1000.0);
+    fprintf(file, ",%.1f,%d,%d,%lld,%lld\n", totalStep / 1000.0, peakCandidates, peakBurning, ignited, burntOut);
+    return fclose(file) == 0;
+}
+
+// Формат Trace Event: фазы - события "X" (начало и длительность в мкс),
+// размеры фронта - счётчики "C". Повторы фазы внутри шага показываются
+// одним блоком от первого начала длиной в суммарное время
+bool StepProfiler::writeTrace(const char* path) const {
+    FILE* file = fopen(path, "w");
+    if (!file) return false;
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (const StepRecord& record : records) {
+        fprintf(file, "%s{\"name\":\"step\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"step\":%d}}",
+                first ? "" : ",\n", record.begin / 1000.0, (record.end - record.begin) / 1000.0, record.step);
+        first = false;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (record.phaseBegin[p] < 0) continue;
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                    PHASE_NAMES[p], record.phaseBegin[p] / 1000.0, record.phaseTime[p] / 1000.0);
+        }
+        fprintf(file, ",\n{\"name\":\"frontier\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"candidates\":%d,\"burning\":%d}}",
+                record.end / 1000.0, record.candidates, record.burning);
+        fprintf(file, ",\n{\"name\":\"events\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"ignited\":%d,\"burnt_out\":%d}}",
+                record.end / 1000.0, record.ignited, record.burntOut);
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,78 @@
+#ifndef STEPPROFILER_H
+#define STEPPROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Замеры фаз шага и размеров фронта. Собирается с FIRE_PROFILING=1
+// (по умолчанию, опция CMake FIRE_PROFILING); без неё FIRE_PROFILE_PHASE
+// пустой и замеров в коде шага нет совсем. Включённый профайлер стоит пару вызовов
+// часов на фазу и одну запись StepRecord на шаг.
+#ifndef FIRE_PROFILING
+#define FIRE_PROFILING 1
+#endif
+
+enum StepPhase { PHASE_IGNITE, PHASE_EXPAND, PHASE_BURN_OUT, PHASE_SMOKE, PHASE_OUTPUT, PHASE_COUNT };
+
+struct StepRecord {
+    int step;
+    std::int64_t begin;                    // нс от начала прогона
+    std::int64_t end;
+    std::int64_t phaseBegin[PHASE_COUNT];  // -1 - фазы не было
+    std::int64_t phaseTime[PHASE_COUNT];
+    int candidates;                        // CheckList после шага
+    int burning;                           // FireList после шага
+    int ignited;
+    int burntOut;
+};
+
+class StepProfiler {
+public:
+    // Профайлер пишет, только если задан хотя бы один файл
+    void open(const char* csvPath, const char* tracePath);
+    bool isOpen() const { return active; }
+
+    void beginStep(int step);
+    void endStep(int candidates, int burning, int ignited, int burntOut);
+    void beginPhase(StepPhase phase);
+    void endPhase(StepPhase phase);
+
+    // CSV по шагам (время в мкс) со строкой итогов и trace-event JSON
+    // (chrome://tracing, Perfetto); записи после этого очищаются
+    bool write();
+
+    // Фаза на время жизни объекта (вывод после шага относится к этому шагу)
+    class Scope {
+    public:
+        Scope(StepProfiler& profiler, StepPhase phase) : profiler(profiler), phase(phase) { profiler.beginPhase(phase); }
+        ~Scope() { profiler.endPhase(phase); }
+
+    private:
+        StepProfiler& profiler;
+        StepPhase phase;
+    };
+
+private:
+    std::int64_t now() const;
+    bool writeCsv(const char* path) const;
+    bool writeTrace(const char* path) const;
+
+    bool active = false;
+    std::string csv;
+    std::string trace;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<StepRecord> records;
+};
+
+#if FIRE_PROFILING
+#define FIRE_PROFILE_CONCAT2(a, b) a##b
+#define FIRE_PROFILE_CONCAT(a, b) FIRE_PROFILE_CONCAT2(a, b)
+#define FIRE_PROFILE_PHASE(profiler, phase) \
+    StepProfiler::Scope FIRE_PROFILE_CONCAT(profileScope, __LINE__)(profiler, phase)
+#else
+#define FIRE_PROFILE_PHASE(profiler, phase) ((void)0)
+#endif
+
+#endif // STEPPROFILER_H
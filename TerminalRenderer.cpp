@@ -0,0 +1,114 @@
+#include "TerminalRenderer.h"
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// Пауза потока вывода, когда нового снимка нет (около 60 кадров в секунду)
+static const std::chrono::milliseconds FRAME_INTERVAL(16);
+
+TerminalRenderer::~TerminalRenderer() {
+    stop();
+}
+
+void TerminalRenderer::start(int height, int width, FILE* output) {
+    stop();
+    h = height;
+    w = width;
+    out = output;
+    for (Frame& frame : frames) {
+        frame.step = -1;
+        frame.cells.assign((std::size_t)h * w, ' ');
+    }
+    back = 0;
+    front = 1;
+    ready.store(2, std::memory_order_relaxed);
+    shown.assign((std::size_t)h * w, 0);
+    drawn.store(0, std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+    stopping.store(false, std::memory_order_relaxed);
+#ifdef _WIN32
+    // Консоль Windows понимает ANSI только с этим режимом
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(console, &mode)) SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#endif
+    // Экран очищается один раз, дальше - только изменившиеся клетки
+    fputs("\x1b[2J", out);
+    thread = std::thread(&TerminalRenderer::renderLoop, this);
+}
+
+void TerminalRenderer::publish(int step, const char* cells) {
+    Frame& frame = frames[back];
+    frame.step = step;
+    memcpy(frame.cells.data(), cells, frame.cells.size());
+    // release: снимок записан до того, как буфер увидит поток вывода
+    int previous = ready.exchange(back | FRESH, std::memory_order_acq_rel);
+    if (previous & FRESH) dropped.fetch_add(1, std::memory_order_relaxed);
+    back = previous & ~FRESH;
+}
+
+bool TerminalRenderer::takeFrame() {
+    if (!(ready.load(std::memory_order_relaxed) & FRESH)) return false;
+    int previous = ready.exchange(front, std::memory_order_acq_rel);
+    front = previous & ~FRESH;
+    return true;
+}
+
+void TerminalRenderer::renderLoop() {
+    for (;;) {
+        // Флаг читается до забора кадра: снимок, опубликованный перед stop,
+        // ещё будет нарисован
+        bool last = stopping.load(std::memory_order_acquire);
+        if (takeFrame()) {
+            draw(frames[front]);
+        } else if (last) {
+            break;
+        } else {
+            std::this_thread::sleep_for(FRAME_INTERVAL);
+        }
+    }
+    // Курсор под карту, чтобы дальнейший вывод не затирал её
+    fprintf(out, "\x1b[%d;1H", h + 2);
+    fflush(out);
+}
+
+// Строка 1 - номер шага, карта с строки 2. Подряд идущие изменившиеся
+// клетки строки выводятся одним куском после одного перемещения курсора
+void TerminalRenderer::draw(const Frame& frame) {
+    text.clear();
+    char move[32];
+    snprintf(move, sizeof(move), "\x1b[1;1HШаг %d\x1b[K", frame.step);
+    text += move;
+    for (int x = 0; x < h; x++) {
+        const char* row = &frame.cells[(std::size_t)x * w];
+        char* screen = &shown[(std::size_t)x * w];
+        int y = 0;
+        while (y < w) {
+            if (row[y] == screen[y]) {
+                y++;
+                continue;
+            }
+            snprintf(move, sizeof(move), "\x1b[%d;%dH", x + 2, y + 1);
+            text += move;
+            while (y < w && row[y] != screen[y]) {
+                text += row[y];
+                screen[y] = row[y];
+                y++;
+            }
+        }
+    }
+    fwrite(text.data(), 1, text.size(), out);
+    fflush(out);
+    drawn.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TerminalRenderer::stop() {
+    if (!thread.joinable()) return;
+    stopping.store(true, std::memory_order_release);
+    thread.join();
+}
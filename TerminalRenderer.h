@@ -0,0 +1,67 @@
+#ifndef TERMINALRENDERER_H
+#define TERMINALRENDERER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Живая карта в терминале на своём потоке. Симулятор после шага публикует
+// снимок слоя (символ на клетку); поток вывода берёт последний снимок и
+// переставляет курсор (ANSI) только к клеткам, изменившимся с его прошлого
+// кадра. Кадры, которые поток не успел нарисовать, пропускаются.
+//
+// Передача снимков без блокировок - тройной буфер: у симулятора буфер
+// записи, у потока вывода буфер чтения, третий лежит в ready. publish и
+// забор кадра меняют свой буфер с ready одной атомарной операцией, так что
+// симулятор никогда не ждёт терминала.
+class TerminalRenderer {
+public:
+    TerminalRenderer() = default;
+    ~TerminalRenderer();
+
+    TerminalRenderer(const TerminalRenderer&) = delete;
+    TerminalRenderer& operator=(const TerminalRenderer&) = delete;
+
+    // Запустить поток вывода для карты height x width
+    void start(int height, int width, FILE* out = stdout);
+    // Снимок после шага step: height * width символов по строкам
+    void publish(int step, const char* cells);
+    // Дорисовать последний снимок и остановить поток
+    void stop();
+
+    bool isRunning() const { return thread.joinable(); }
+    std::int64_t framesDrawn() const { return drawn.load(std::memory_order_relaxed); }
+    // Снимки, заменённые следующими до того, как их забрал поток вывода
+    std::int64_t framesDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Frame {
+        int step;
+        std::vector<char> cells;
+    };
+    // В ready: номер буфера и бит нового, ещё не забранного снимка
+    static constexpr int FRESH = 4;
+
+    void renderLoop();
+    bool takeFrame();
+    void draw(const Frame& frame);
+
+    int h = 0;
+    int w = 0;
+    FILE* out = nullptr;
+    Frame frames[3];
+    int back = 0;                 // буфер симулятора
+    int front = 1;                // буфер потока вывода
+    std::atomic<int> ready{2};
+    std::vector<char> shown;      // что сейчас на экране, 0 - ещё не рисовали
+    std::string text;
+    std::atomic<bool> stopping{false};
+    std::atomic<std::int64_t> drawn{0};
+    std::atomic<std::int64_t> dropped{0};
+    std::thread thread;
+};
+
+#endif // TERMINALRENDERER_H
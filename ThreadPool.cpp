@@ -0,0 +1,151 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int count)
+    : generation(0), remaining(0), stopping(false), callerPinned(false) {
+    if (count <= 0) count = (int)std::thread::hardware_concurrency();
+    if (count <= 0) count = 1;
+
+    for (int i = 0; i < count; i++) queues.emplace_back(new Queue);
+    for (int i = 1; i < count; i++) threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) thread.join();
+#ifdef __linux__
+    // Вызывающему потоку возвращается маска, которая была до pinThreads
+    if (callerPinned) pthread_setaffinity_np(caller, sizeof(callerMask), &callerMask);
+#endif
+}
+
+void ThreadPool::parallelFor(std::int64_t count, std::int64_t grain, const RangeBody& body) {
+    if (count <= 0) return;
+    if (grain <= 0) grain = 1;
+    if (size() == 1 || count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    // Каждому потоку достаётся непрерывный блок кусков, остальное - перехватом
+    std::int64_t chunks = (count + grain - 1) / grain;
+    remaining.store(chunks, std::memory_order_relaxed);
+    int workers = size();
+    for (int w = 0; w < workers; w++) {
+        std::int64_t first = chunks * w / workers;
+        std::int64_t last = chunks * (w + 1) / workers;
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        for (std::int64_t c = first; c < last; c++) {
+            std::int64_t begin = c * grain;
+            std::int64_t end = begin + grain < count ? begin + grain : count;
+            queues[w]->ranges.push_back(Range{begin, end, &body, true});
+        }
+    }
+    dispatch();
+}
+
+void ThreadPool::forEachWorker(const WorkerBody& body) {
+    if (size() == 1) {
+        body(0);
+        return;
+    }
+    RangeBody worker = [&body](std::int64_t begin, std::int64_t) { body((int)begin); };
+    remaining.store(size(), std::memory_order_relaxed);
+    for (int w = 0; w < size(); w++) {
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        queues[w]->ranges.push_back(Range{w, w + 1, &worker, false});
+    }
+    dispatch();
+}
+
+// Куски уже разложены по очередям: будим потоки и работаем сами как поток 0
+void ThreadPool::dispatch() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    while (runOne(0)) {}
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return remaining.load(std::memory_order_acquire) == 0; });
+}
+
+// Процессоры берутся по кругу из тех, что разрешены вызывающему потоку
+bool ThreadPool::pinThreads() {
+#ifdef __linux__
+    if (!callerPinned) {
+        caller = pthread_self();
+        if (pthread_getaffinity_np(caller, sizeof(callerMask), &callerMask) != 0) return false;
+    }
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &callerMask)) cpus.push_back(cpu);
+    }
+    if (cpus.empty()) return false;
+    bool ok = true;
+    for (int w = 0; w < size(); w++) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[w % cpus.size()], &set);
+        pthread_t handle = w == 0 ? caller : threads[w - 1].native_handle();
+        bool pinned = pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+        if (w == 0) callerPinned = callerPinned || pinned;
+        ok = pinned && ok;
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
+void ThreadPool::workerLoop(int worker) {
+    std::uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        while (runOne(worker)) {}
+    }
+}
+
+// Берём кусок с конца своей очереди, иначе крадём с начала чужой
+// (кроме кусков forEachWorker)
+bool ThreadPool::runOne(int worker) {
+    Range range;
+    bool found = false;
+    {
+        Queue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.ranges.empty()) {
+            range = own.ranges.back();
+            own.ranges.pop_back();
+            found = true;
+        }
+    }
+    for (int i = 1; !found && i < size(); i++) {
+        Queue& victim = *queues[(worker + i) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.ranges.empty() && victim.ranges.front().shared) {
+            range = victim.ranges.front();
+            victim.ranges.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    (*range.body)(range.begin, range.end);
+
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+    }
+    return true;
+}
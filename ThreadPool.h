@@ -0,0 +1,83 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Пул потоков с перехватом работы (work stealing).
+// parallelFor режет диапазон на куски по grain элементов и раздаёт их
+// потокам подряд; освободившийся поток забирает куски из чужих очередей.
+// Вызывающий поток работает вместе с пулом как поток 0.
+class ThreadPool {
+public:
+    typedef std::function<void(std::int64_t begin, std::int64_t end)> RangeBody;
+    typedef std::function<void(int worker)> WorkerBody;
+
+    // threads = 0 - по числу ядер
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)queues.size(); }
+
+    // body не должен бросать исключений
+    void parallelFor(std::int64_t count, std::int64_t grain, const RangeBody& body);
+    // body(w) ровно один раз на каждом потоке w, без перехвата: работа,
+    // привязанная к своему потоку (и его памяти)
+    void forEachWorker(const WorkerBody& body);
+    // Закрепить поток w за процессором w (по кругу), включая вызывающий:
+    // он работает как поток 0 и первым касается памяти своего куска.
+    // Прежняя маска вызывающего потока возвращается при разрушении пула.
+    // false - система не поддерживает
+    bool pinThreads();
+
+private:
+    // Кусок несёт тело своего запуска и признак, можно ли его красть:
+    // поток, задержавшийся в перехвате прошлого запуска, проверяет его под
+    // замком очереди и не заберёт чужую работу forEachWorker
+    struct Range {
+        std::int64_t begin;
+        std::int64_t end;
+        const RangeBody* body;
+        bool shared;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    void dispatch();
+    void workerLoop(int worker);
+    bool runOne(int worker);
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::uint64_t generation;
+    std::atomic<std::int64_t> remaining;
+    bool stopping;
+    bool callerPinned;
+#ifdef __linux__
+    pthread_t caller;
+    cpu_set_t callerMask;
+#endif
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,236 @@
+#ifndef VOXELGRID_H
+#define VOXELGRID_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "FrontierSet.h"
+#include "MappedFile.h"
+
+// Сетка клеток, размеры задаются во время выполнения, данные лежат в куче.
+// Клетки хранятся тайлами (до 8x8x8), индекс клетки - номер тайла * размер тайла
+// + смещение внутри тайла, так соседи по всем осям лежат рядом в памяти.
+//
+// Если задан storePath, тайлы живут в файле и отображаются в память только
+// при обращении к ним; releaseTilesExcept() выгружает тайлы вдали от фронта,
+// так что в памяти остаётся только окрестность пожара.
+//
+// В памяти клетки не обнуляются: их заполняет тот, кто первым коснётся
+// тайла (при разбиении на слои - поток-владелец, страницы ложатся на его узел).
+//
+// allocateSparse() - разреженное хранение: тайл (брик) создаётся и заполняется
+// инициализатором при первом обращении, нетронутые части здания памяти не занимают.
+template <class Cell>
+class VoxelGrid {
+    static_assert(std::is_trivially_copyable<Cell>::value, "клетка должна копироваться побайтно");
+
+public:
+    static const int MAX_TILE_SHIFT = 3; // 8 клеток по оси
+
+    typedef std::function<void(CellIndex tile, Cell* cells)> TileInitializer;
+
+    VoxelGrid() {}
+    ~VoxelGrid() { release(); }
+
+    VoxelGrid(const VoxelGrid&) = delete;
+    VoxelGrid& operator=(const VoxelGrid&) = delete;
+
+    bool allocate(int height, int width, int depth, const char* storePath = nullptr) {
+        if (!setShape(height, width, depth)) return false;
+
+        if (storePath) {
+            std::size_t gran = MappedFile::granularity();
+            tileBytes = sizeof(Cell) * tileCells;
+            tileStride = (tileBytes + gran - 1) / gran * gran;
+            if (!store.create(storePath, (std::uint64_t)tileStride * numTiles)) {
+                release();
+                return false;
+            }
+            for (CellIndex t = 0; t < numTiles; t++) tiles[t].store(nullptr, std::memory_order_relaxed);
+        } else {
+            heap.reset(new Cell[(std::size_t)numTiles * tileCells]);
+            for (CellIndex t = 0; t < numTiles; t++) {
+                tiles[t].store(heap.get() + (std::size_t)t * tileCells, std::memory_order_relaxed);
+            }
+        }
+        resident = 0;
+        return true;
+    }
+
+    bool allocateSparse(int height, int width, int depth, const TileInitializer& initializer) {
+        if (!setShape(height, width, depth)) return false;
+        for (CellIndex t = 0; t < numTiles; t++) tiles[t].store(nullptr, std::memory_order_relaxed);
+        initTile = initializer;
+        sparse = true;
+        resident = 0;
+        return true;
+    }
+
+    void release() {
+        if (store.isOpen()) {
+            for (CellIndex t = 0; t < numTiles; t++) releaseTile(t);
+            store.close();
+        }
+        if (sparse) {
+            for (CellIndex t = 0; t < numTiles; t++) delete[] tiles[t].load(std::memory_order_relaxed);
+            sparse = false;
+            initTile = nullptr;
+        }
+        tiles.reset();
+        heap.reset();
+        numTiles = 0;
+        resident = 0;
+    }
+
+    int height() const { return h; }
+    int width() const { return w; }
+    int depth() const { return d; }
+
+    // Число ячеек хранилища (вместе с дополнением до целых тайлов)
+    CellIndex cellCount() const { return numTiles << cellShift; }
+
+    bool inside(int x, int y, int z) const {
+        return x >= 0 && x < h && y >= 0 && y < w && z >= 0 && z < d;
+    }
+
+    CellIndex index(int x, int y, int z) const {
+        CellIndex tile = ((CellIndex)(x >> sx) * tilesY + (y >> sy)) * tilesZ + (z >> sz);
+        int local = ((((x & ((1 << sx) - 1)) << sy) | (y & ((1 << sy) - 1))) << sz) | (z & ((1 << sz) - 1));
+        return (tile << cellShift) | local;
+    }
+
+    void coords(CellIndex index, int& x, int& y, int& z) const {
+        CellIndex tile = index >> cellShift;
+        int local = (int)(index & (tileCells - 1));
+        int tz = (int)(tile % tilesZ);
+        int ty = (int)(tile / tilesZ % tilesY);
+        int tx = (int)(tile / tilesZ / tilesY);
+        x = (tx << sx) | (local >> (sy + sz));
+        y = (ty << sy) | ((local >> sz) & ((1 << sy) - 1));
+        z = (tz << sz) | (local & ((1 << sz) - 1));
+    }
+
+    Cell& operator[](CellIndex index) {
+        CellIndex tile = index >> cellShift;
+        Cell* cells = tiles[tile].load(std::memory_order_acquire);
+        if (!cells) cells = pageIn(tile);
+        return cells[index & (tileCells - 1)];
+    }
+
+    Cell& at(int x, int y, int z) { return (*this)[index(x, y, z)]; }
+
+    // Тайлы
+    CellIndex tileCount() const { return numTiles; }
+    int cellsPerTile() const { return tileCells; }
+    int tileHeight() const { return 1 << sx; }
+    CellIndex tileOf(CellIndex index) const { return index >> cellShift; }
+    bool isOutOfCore() const { return store.isOpen(); }
+    bool isSparse() const { return sparse; }
+    // Тайл уже в памяти (в плотном режиме - всегда)
+    bool isTileResident(CellIndex tile) const { return tiles[tile].load(std::memory_order_acquire) != nullptr; }
+    // Тайлов в памяти в файловом и разреженном режимах
+    CellIndex residentTiles() const { return resident; }
+
+    // Обойти тайл и соседние с ним тайлы (включая сам тайл)
+    template <class F>
+    void forEachNeighbourTile(CellIndex tile, F f) const {
+        int tz = (int)(tile % tilesZ);
+        int ty = (int)(tile / tilesZ % tilesY);
+        int tx = (int)(tile / tilesZ / tilesY);
+        for (int dx = -1; dx <= 1; dx++) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dz = -1; dz <= 1; dz++) {
+                    int nx = tx + dx, ny = ty + dy, nz = tz + dz;
+                    if (nx < 0 || nx >= tilesX || ny < 0 || ny >= tilesY || nz < 0 || nz >= tilesZ) continue;
+                    f(((CellIndex)nx * tilesY + ny) * tilesZ + nz);
+                }
+            }
+        }
+    }
+
+    // Выгрузить тайл из памяти (изменения остаются в файле). Разреженный брик
+    // удаляется, при следующем обращении инициализатор создаст его заново
+    void releaseTile(CellIndex tile) {
+        if (!store.isOpen() && !sparse) return;
+        Cell* cells = tiles[tile].exchange(nullptr, std::memory_order_acq_rel);
+        if (!cells) return;
+        if (sparse) delete[] cells;
+        else store.unmap(cells, tileBytes);
+        resident--;
+    }
+
+    // Выгрузить все тайлы, не отмеченные в keep
+    void releaseTilesExcept(const std::vector<char>& keep) {
+        if (!store.isOpen()) return;
+        for (CellIndex t = 0; t < numTiles; t++) {
+            if (!keep[t]) releaseTile(t);
+        }
+    }
+
+private:
+    bool setShape(int height, int width, int depth) {
+        release();
+        if (height <= 0 || width <= 0 || depth <= 0) return false;
+        h = height;
+        w = width;
+        d = depth;
+        sx = tileShift(h);
+        sy = tileShift(w);
+        sz = tileShift(d);
+        tilesX = (h + (1 << sx) - 1) >> sx;
+        tilesY = (w + (1 << sy) - 1) >> sy;
+        tilesZ = (d + (1 << sz) - 1) >> sz;
+        cellShift = sx + sy + sz;
+        tileCells = 1 << cellShift;
+        numTiles = (CellIndex)tilesX * tilesY * tilesZ;
+        tiles.reset(new std::atomic<Cell*>[numTiles]);
+        return true;
+    }
+
+    static int tileShift(int size) {
+        int shift = 0;
+        while (shift < MAX_TILE_SHIFT && (1 << shift) < size) shift++;
+        return shift;
+    }
+
+    Cell* pageIn(CellIndex tile) {
+        std::lock_guard<std::mutex> lock(pageMutex);
+        Cell* cells = tiles[tile].load(std::memory_order_acquire);
+        if (!cells) {
+            if (sparse) {
+                cells = new Cell[tileCells]();
+                initTile(tile, cells);
+            } else {
+                cells = (Cell*)store.map((std::uint64_t)tile * tileStride, tileBytes);
+                if (!cells) throw std::bad_alloc();
+            }
+            tiles[tile].store(cells, std::memory_order_release);
+            resident++;
+        }
+        return cells;
+    }
+
+    int h = 0, w = 0, d = 0;
+    int sx = 0, sy = 0, sz = 0;
+    int tilesX = 0, tilesY = 0, tilesZ = 0;
+    int cellShift = 0;
+    int tileCells = 1;
+    CellIndex numTiles = 0;
+
+    std::unique_ptr<std::atomic<Cell*>[]> tiles;
+    std::unique_ptr<Cell[]> heap;
+
+    MappedFile store;
+    std::size_t tileBytes = 0;
+    std::size_t tileStride = 0;
+    bool sparse = false;
+    TileInitializer initTile;
+    CellIndex resident = 0;
+    std::mutex pageMutex;
+};
+
+#endif // VOXELGRID_H
@@ -2,15 +2,35 @@
 #ifndef ROOM_HPP
 #define ROOM_HPP
 
+// Помещение плана: связная область проходимых клеток одного этажа,
+// ограниченная стенами и дверями
 class Room
 {
 public:
     Room(int id);
-    // Можете добавить другие методы и свойства
+    Room(int id, int floor);
+
+    int getId() const { return id; }
+    int getFloor() const { return floor; }
+    int getCellCount() const { return cellCount; }
+    double getFuelMass() const { return fuelMass; }
+
+    // Ограничивающий прямоугольник по x, y (включительно)
+    int getMinX() const { return minX; }
+    int getMaxX() const { return maxX; }
+    int getMinY() const { return minY; }
+    int getMaxY() const { return maxY; }
+
+    // Клетка (x, y) этажа с запасом топлива fuel
+    void addCell(int x, int y, double fuel);
 
 private:
     int id;
-    // Другие свойства помещения
+    int floor;
+    int cellCount;
+    double fuelMass;
+    int minX, maxX;
+    int minY, maxY;
 };
 
-#endif // ROOM_HPP
\ No newline at end of file
+#endif // ROOM_HPP
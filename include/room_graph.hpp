@@ -3,19 +3,69 @@
 #define ROOMGRAPH_HPP
 
 #include "room.hpp"
+#include <cstdint>
 #include <vector>
 #include <map>
 
+class FloorPlan;
+
+// Дверной проём: связная группа клеток-дверей одного этажа
+struct Door {
+    int floor;
+    int cellCount;
+    std::vector<int> rooms; // помещения, к которым примыкает проём
+};
+
+// Граф помещений: вершины - помещения, рёбра - проёмы и перекрытия между этажами,
+// вес ребра - ширина проёма (площадь перекрытия) в клетках плана
 class RoomGraph {
 public:
     void addRoom(const Room& room);
     void addConnection(int roomId1, int roomId2, double connectionStrength);
 
-    // Можете добавить другие методы и свойства
+    // Разбиение плана: помещение - связная по граням область проходимых клеток
+    // этажа без дверей, проём соединяет все помещения, к которым примыкает.
+    // Помещения соседних этажей, у которых есть проходимые клетки друг над
+    // другом, тоже соединяются. Номера помещений - 0..roomCount()-1
+    void build(const FloorPlan& plan);
+    void clear();
+
+    int roomCount() const { return (int)rooms.size(); }
+    const Room& room(int id) const { return rooms.at(id); }
+    const std::vector<std::pair<int, double>>& neighbours(int id) const;
+    int doorCount() const { return (int)doors.size(); }
+    const Door& door(int index) const { return doors[index]; }
+    const std::vector<int>& doorsOf(int id) const;
+
+    // Слои z этажа: [floorBegin, floorEnd)
+    int floorBegin(int floor) const { return floorStart[floor]; }
+    int floorEnd(int floor) const { return floorStart[floor + 1]; }
+
+    // Помещение клетки, -1 - стена или дверь
+    int roomAt(int x, int y, int z) const {
+        int zone = zoneAt(x, y, z);
+        return zone >= 0 ? zone : -1;
+    }
+    // Проём клетки, -1 - не дверь
+    int doorAt(int x, int y, int z) const {
+        int zone = zoneAt(x, y, z);
+        return zone <= -2 ? -2 - zone : -1;
+    }
 
 private:
+    int zoneAt(int x, int y, int z) const {
+        return cellZones[((std::size_t)zFloor[z] * h + x) * w + y];
+    }
+
     std::map<int, Room> rooms;
     std::map<int, std::vector<std::pair<int, double>>> adjacencyList;
+    std::map<int, std::vector<int>> roomDoors;
+    std::vector<Door> doors;
+    std::vector<std::int32_t> cellZones; // по клеткам этажей: помещение, -1 - стена, -2 - k - проём k
+    std::vector<int> zFloor;
+    std::vector<int> floorStart;
+    int h = 0;
+    int w = 0;
 };
 
-#endif // ROOMGRAPH_HPP
\ No newline at end of file
+#endif // ROOMGRAPH_HPP
@@ -1,7 +1,146 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "Ensemble.h"
 #include "FireSimulation.h"
 
-int main() {
-    FireSimulation simulator;
-    simulator.runSimulation();
+// Без аргументов - один прогон с живой картой в терминале (TerminalRenderer.h),
+//            [--changes файл.csv] - журнал изменений клеток
+// --headless [--max-steps N] [--counts] [--frames K] [--no-final]
+//            [--record файл --keyframes K] [--tenability файл.csv]
+//            [--metrics файл.csv]
+//            [--save-checkpoint файл [--checkpoint-step N]] - пакетный режим
+// --ensemble N [--out файл.csv] - ансамбль из N прогонов
+// --seed S, --threads T, --sparse (разреженные брики),
+// --events (событийный движок), --plan файл (план здания),
+// --materials файл (таблица материалов, по умолчанию fire.json рядом с программой),
+// --zones (зональная модель по помещениям),
+// --smoke (поля дыма и газов),
+// --checkpoint файл (продолжить с контрольной точки) - общие для всех режимов
+// --2d - плоский движок (окрестность фон Неймана), кроме ансамбля
+// --domains - разбиение сетки на слои по потокам, кроме ансамбля
+// --profile файл.csv, --trace файл.json - замеры фаз шага, кроме ансамбля
+template <class Engine>
+static void run(Engine& simulator, bool headless, const HeadlessOptions& options) {
+    if (headless) {
+        simulator.runHeadless(options);
+    } else {
+        simulator.runSimulation();
+    }
+}
+
+int main(int argc, char** argv) {
+    int realizations = 0;
+    bool headless = false;
+    bool seedSet = false;
+    unsigned long long seed = 1;
+    int threads = 0;
+    bool sparse = false;
+    bool events = false;
+    bool zones = false;
+    bool smoke = false;
+    bool metrics = false;
+    bool slabs = false;
+    bool planar = false;
+    const char* planPath = nullptr;
+    // Без --materials - fire.json из каталога программы, как у FireBench
+    std::string defaultMaterials = besideBinary(argv[0], "fire.json");
+    const char* materialsPath = defaultMaterials.c_str();
+    const char* profilePath = nullptr;
+    const char* tracePath = nullptr;
+    const char* changesPath = nullptr;
+    const char* checkpointPath = nullptr;
+    const char* out = "ensemble.csv";
+    HeadlessOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--ensemble") && i + 1 < argc) realizations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) { seed = strtoull(argv[++i], nullptr, 10); seedSet = true; }
+        else if (!strcmp(argv[i], "--out") && i + 1 < argc) out = argv[++i];
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--headless")) headless = true;
+        else if (!strcmp(argv[i], "--sparse")) sparse = true;
+        else if (!strcmp(argv[i], "--events")) events = true;
+        else if (!strcmp(argv[i], "--zones")) zones = true;
+        else if (!strcmp(argv[i], "--smoke")) smoke = true;
+        else if (!strcmp(argv[i], "--tenability") && i + 1 < argc) { options.tenabilityPath = argv[++i]; smoke = true; }
+        else if (!strcmp(argv[i], "--metrics") && i + 1 < argc) { options.metricsPath = argv[++i]; metrics = true; }
+        else if (!strcmp(argv[i], "--domains")) slabs = true;
+        else if (!strcmp(argv[i], "--2d")) planar = true;
+        else if (!strcmp(argv[i], "--plan") && i + 1 < argc) planPath = argv[++i];
+        else if (!strcmp(argv[i], "--materials") && i + 1 < argc) materialsPath = argv[++i];
+        else if (!strcmp(argv[i], "--profile") && i + 1 < argc) profilePath = argv[++i];
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc) tracePath = argv[++i];
+        else if (!strcmp(argv[i], "--changes") && i + 1 < argc) changesPath = argv[++i];
+        else if (!strcmp(argv[i], "--max-steps") && i + 1 < argc) options.maxSteps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--counts")) options.stepCounts = true;
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc) options.frameEvery = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-final")) options.finalFrame = false;
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc) options.recordPath = argv[++i];
+        else if (!strcmp(argv[i], "--keyframes") && i + 1 < argc) options.keyframeEvery = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--checkpoint") && i + 1 < argc) checkpointPath = argv[++i];
+        else if (!strcmp(argv[i], "--save-checkpoint") && i + 1 < argc) options.checkpointPath = argv[++i];
+        else if (!strcmp(argv[i], "--checkpoint-step") && i + 1 < argc) options.checkpointStep = atoi(argv[++i]);
+    }
+
+    // Точка читается один раз, все прогоны ансамбля делят её
+    std::shared_ptr<const Checkpoint> checkpoint;
+    if (checkpointPath) {
+        checkpoint = Checkpoint::load(checkpointPath);
+        if (!checkpoint) {
+            printf("Не удалось прочитать контрольную точку %s\n", checkpointPath);
+            return 1;
+        }
+    }
+
+    // Общие настройки прогона для любого движка
+    auto configure = [&](auto& simulation) {
+        simulation.setThreadCount(threads);
+        simulation.setMaterials(materialsPath);
+        simulation.setFloorPlan(planPath);
+        simulation.setSparseBricks(sparse);
+        simulation.setEventDriven(events);
+        simulation.setZoneModel(zones);
+        simulation.setSmoke(smoke);
+        simulation.setMetrics(metrics);
+        simulation.setCheckpoint(checkpoint);
+    };
+
+    if (realizations > 0) {
+        if (planar) {
+            printf("Ансамбль считается только в 3D\n");
+            return 1;
+        }
+        if (slabs) {
+            printf("Ансамбль делит потоки между прогонами, --domains не поддерживается\n");
+            return 1;
+        }
+        EnsembleOptions ensembleOptions;
+        ensembleOptions.realizations = realizations;
+        ensembleOptions.baseSeed = seed;
+        ensembleOptions.concurrency = threads;
+        Ensemble ensemble;
+        if (!ensemble.run(ensembleOptions, [&](FireSimulation& simulation) { configure(simulation); })) return 1;
+        printf("Прогонов: %d\n", ensemble.completed());
+        return ensemble.writeCsv(out) ? 0 : 1;
+    }
+
+    if (planar) {
+        FireSimulation2D simulator;
+        configure(simulator);
+        simulator.setSlabDomains(slabs);
+        simulator.setProfile(profilePath, tracePath);
+        simulator.setChangeLog(changesPath);
+        if (seedSet) simulator.setSeed(seed);
+        run(simulator, headless, options);
+    } else {
+        FireSimulation simulator;
+        configure(simulator);
+        simulator.setSlabDomains(slabs);
+        simulator.setProfile(profilePath, tracePath);
+        simulator.setChangeLog(changesPath);
+        if (seedSet) simulator.setSeed(seed);
+        run(simulator, headless, options);
+    }
     return 0;
-}
\ No newline at end of file
+}
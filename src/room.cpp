@@ -2,4 +2,22 @@
 #include "room.hpp"
 
 Room::Room(int id)
-    : id(id) {}
+    : Room(id, 0) {}
+
+Room::Room(int id, int floor)
+    : id(id), floor(floor), cellCount(0), fuelMass(0),
+      minX(0), maxX(-1), minY(0), maxY(-1) {}
+
+void Room::addCell(int x, int y, double fuel) {
+    if (cellCount == 0) {
+        minX = maxX = x;
+        minY = maxY = y;
+    } else {
+        if (x < minX) minX = x;
+        if (x > maxX) maxX = x;
+        if (y < minY) minY = y;
+        if (y > maxY) maxY = y;
+    }
+    cellCount++;
+    fuelMass += fuel;
+}
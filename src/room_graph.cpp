@@ -1,10 +1,141 @@
 // room_graph.cpp
 #include "room_graph.hpp"
+#include <algorithm>
+#include "FloorPlan.h"
 
 void RoomGraph::addRoom(const Room& room) {
-    // Реализация метода
+    rooms.erase(room.getId());
+    rooms.emplace(room.getId(), room);
+    adjacencyList[room.getId()];
 }
 
+// Повторное ребро между теми же помещениями складывается с прежним
 void RoomGraph::addConnection(int roomId1, int roomId2, double connectionStrength) {
-    // Реализация метода
+    if (roomId1 == roomId2) return;
+    for (int side = 0; side < 2; side++) {
+        int from = side == 0 ? roomId1 : roomId2;
+        int to = side == 0 ? roomId2 : roomId1;
+        std::vector<std::pair<int, double>>& edges = adjacencyList[from];
+        std::vector<std::pair<int, double>>::iterator edge = edges.begin();
+        while (edge != edges.end() && edge->first != to) ++edge;
+        if (edge == edges.end()) edges.push_back(std::make_pair(to, connectionStrength));
+        else edge->second += connectionStrength;
+    }
+}
+
+void RoomGraph::clear() {
+    rooms.clear();
+    adjacencyList.clear();
+    roomDoors.clear();
+    doors.clear();
+    cellZones.clear();
+    zFloor.clear();
+    floorStart.clear();
+    h = 0;
+    w = 0;
+}
+
+const std::vector<std::pair<int, double>>& RoomGraph::neighbours(int id) const {
+    static const std::vector<std::pair<int, double>> none;
+    std::map<int, std::vector<std::pair<int, double>>>::const_iterator it = adjacencyList.find(id);
+    return it == adjacencyList.end() ? none : it->second;
+}
+
+const std::vector<int>& RoomGraph::doorsOf(int id) const {
+    static const std::vector<int> none;
+    std::map<int, std::vector<int>>::const_iterator it = roomDoors.find(id);
+    return it == roomDoors.end() ? none : it->second;
+}
+
+void RoomGraph::build(const FloorPlan& plan) {
+    clear();
+    h = plan.height();
+    w = plan.width();
+    int floors = plan.floors();
+    for (int z = 0; z < plan.depth(); z++) zFloor.push_back(plan.floorOf(z));
+    floorStart.assign(floors + 1, plan.depth());
+    for (int z = plan.depth() - 1; z >= 0; z--) floorStart[zFloor[z]] = z;
+    cellZones.assign((std::size_t)floors * h * w, -1);
+
+    const int DX[4] = {-1, 1, 0, 0};
+    const int DY[4] = {0, 0, -1, 1};
+    std::vector<std::pair<int, int>> stack;
+    int nextRoom = 0;
+    for (int floor = 0; floor < floors; floor++) {
+        int z = floorStart[floor];
+        int slices = floorStart[floor + 1] - z;
+        std::int32_t* zones = &cellZones[(std::size_t)floor * h * w];
+
+        // Помещения и проёмы - заливкой по граням
+        for (int x = 0; x < h; x++) {
+            for (int y = 0; y < w; y++) {
+                if (zones[x * w + y] != -1 || !plan.passable(x, y, z)) continue;
+                bool isDoor = plan.door(x, y, z);
+                std::int32_t zone;
+                if (isDoor) {
+                    zone = -2 - (std::int32_t)doors.size();
+                    doors.push_back(Door{floor, 0, std::vector<int>()});
+                } else {
+                    zone = nextRoom++;
+                    addRoom(Room(zone, floor));
+                }
+                Room* room = isDoor ? nullptr : &rooms.at(zone);
+                zones[x * w + y] = zone;
+                stack.assign(1, std::make_pair(x, y));
+                while (!stack.empty()) {
+                    int cx = stack.back().first;
+                    int cy = stack.back().second;
+                    stack.pop_back();
+                    if (isDoor) doors.back().cellCount++;
+                    else room->addCell(cx, cy, plan.material(cx, cy, z).fuelMass * slices);
+                    for (int n = 0; n < 4; n++) {
+                        int nx = cx + DX[n];
+                        int ny = cy + DY[n];
+                        if (nx < 0 || nx >= h || ny < 0 || ny >= w || zones[nx * w + ny] != -1) continue;
+                        if (!plan.passable(nx, ny, z) || plan.door(nx, ny, z) != isDoor) continue;
+                        zones[nx * w + ny] = zone;
+                        stack.push_back(std::make_pair(nx, ny));
+                    }
+                }
+            }
+        }
+
+        // Проём соединяет помещения, которых касается по граням
+        for (int x = 0; x < h; x++) {
+            for (int y = 0; y < w; y++) {
+                std::int32_t zone = zones[x * w + y];
+                if (zone > -2) continue;
+                Door& door = doors[-2 - zone];
+                for (int n = 0; n < 4; n++) {
+                    int nx = x + DX[n];
+                    int ny = y + DY[n];
+                    if (nx < 0 || nx >= h || ny < 0 || ny >= w || zones[nx * w + ny] < 0) continue;
+                    int room = zones[nx * w + ny];
+                    if (std::find(door.rooms.begin(), door.rooms.end(), room) == door.rooms.end()) door.rooms.push_back(room);
+                }
+            }
+        }
+    }
+    for (int d = 0; d < (int)doors.size(); d++) {
+        const Door& door = doors[d];
+        for (std::size_t i = 0; i < door.rooms.size(); i++) {
+            roomDoors[door.rooms[i]].push_back(d);
+            for (std::size_t j = i + 1; j < door.rooms.size(); j++) {
+                addConnection(door.rooms[i], door.rooms[j], door.cellCount);
+            }
+        }
+    }
+
+    // Перекрытия: помещения соседних этажей над одними и теми же клетками
+    for (int floor = 0; floor + 1 < floors; floor++) {
+        const std::int32_t* lower = &cellZones[(std::size_t)floor * h * w];
+        const std::int32_t* upper = &cellZones[(std::size_t)(floor + 1) * h * w];
+        std::map<std::pair<int, int>, int> overlap;
+        for (std::size_t i = 0; i < (std::size_t)h * w; i++) {
+            if (lower[i] >= 0 && upper[i] >= 0) overlap[std::make_pair(lower[i], upper[i])]++;
+        }
+        for (const std::pair<const std::pair<int, int>, int>& pair : overlap) {
+            addConnection(pair.first.first, pair.first.second, pair.second);
+        }
+    }
 }